@@ -0,0 +1,212 @@
+#pragma once
+
+#include <BoundedQueue.hpp>
+#include <Expect.hpp>
+#include <Tensor.hpp>
+#include <ThreadPool.hpp>
+
+#include "ColorMap.hpp"
+#include "Engine.hpp"
+#include "Output.hpp"
+#include "RenderParams.hpp"
+#include "Reproject.hpp"
+#include "Time.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+
+    zoom animations: a sequence of frames centered on one point, whose zoom grows geometrically from 1 to the
+    requested zoom so every frame magnifies the one before it by the same factor; when that factor is a whole number,
+    the pixels a frame shares with the one before it are copied instead of computed again (see Reproject.hpp). the
+    point sits on a pixel of every frame, even of an even size, so the pixel grids of the frames line up for any factor
+
+    rendering a frame already keeps every core busy, but encoding one mostly runs on a single thread, so frames are
+    handed to encoder threads of their own while the pool goes on to render the next ones; finished frames wait in a
+    bounded queue, so a renderer that outpaces the encoders blocks instead of piling frames up in memory
+
+*/
+
+// number of threads encoding frames when none is requested
+static constexpr size_t k_default_animation_encoders = 2;
+
+// time spent on each stage of an animation, summed over its frames, and how much of the work was skipped
+struct AnimationStats
+{
+    chrono::duration<double> rendering{0.0};
+    chrono::duration<double> encoding{0.0};
+    size_t reused_pixels = 0; // copied from the frame before
+    size_t total_pixels = 0;
+};
+
+/** @brief Get the zoom of one frame of an animation.
+ * @param[in] zoom The zoom of the last frame; the first frame has a zoom of 1.
+ * @param[in] frame The index of the frame.
+ * @param[in] frame_count The number of frames in the animation.
+ * @returns The zoom of the frame.
+ */
+auto GetFrameZoom(double zoom, size_t frame, size_t frame_count) -> double
+{
+    if (frame_count < 2)
+    {
+        return zoom;
+    }
+
+    return std::pow(zoom, static_cast<double>(frame) / static_cast<double>(frame_count - 1));
+}
+
+/** @brief Get the path of one frame of an animation by numbering the output path, so zoom.png becomes zoom_0007.png.
+ * @param[in] path The output path of the animation.
+ * @param[in] frame The index of the frame.
+ * @param[in] frame_count The number of frames, which sets how many digits every frame number is padded to.
+ * @returns The path of the frame.
+ */
+auto GetFramePath(std::string const& path, size_t frame, size_t frame_count) -> std::string
+{
+    size_t const digits = std::max<size_t>(4, std::to_string(frame_count - 1).size());
+
+    std::string number = std::to_string(frame);
+    number.insert(0, digits - number.size(), '0');
+
+    std::filesystem::path frame_path(path);
+    frame_path.replace_filename(frame_path.stem().string() + "_" + number + frame_path.extension().string());
+    return frame_path.string();
+}
+
+/** @brief Render a zoom animation into numbered image files, encoding finished frames while later ones render.
+ *
+ * At most one finished frame waits for an encoder, so besides the frame being rendered (and the iteration counts of
+ * the one before it) no more than encoders + 1 frames are held in memory at once.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, center, and iteration limit of every frame, and the zoom of the last one.
+ * @param[in] colormap The color palette to use.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] frame_count The number of frames to render.
+ * @param[in] output_path The path the frame paths are made from (see GetFramePath()).
+ * @param[in] format The format to write the frames in.
+ * @param[in] compression The deflate compression level (png only).
+ * @param[in] encoders The number of threads encoding frames.
+ * @returns The time spent rendering and encoding, summed over the frames, and the number of pixels reused.
+ */
+auto RenderAnimation(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, size_t frame_count, std::string const& output_path, ImageFormat format, int compression, size_t encoders) -> AnimationStats
+{
+    Expect(frame_count > 0, "error: an animation needs at least one frame");
+    Expect(encoders > 0, "error: an animation needs at least one encoder thread");
+
+    struct Frame
+    {
+        size_t index;
+        Tensor<uint8_t, 3> image;
+    };
+
+    BoundedQueue<Frame> queue(1);
+    AnimationStats stats;
+
+    // the first error an encoder runs into; the rest of the frames are dropped and it is rethrown once they stop
+    std::mutex mutex;
+    std::exception_ptr failure;
+    std::atomic<bool> failed = false;
+
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < encoders; ++thread)
+    {
+        threads.emplace_back([&]()
+        {
+            while (auto frame = queue.Pop())
+            {
+                if (failed)
+                {
+                    continue;
+                }
+
+                try
+                {
+                    auto elapsed = Time([&]()
+                    {
+                        WriteImage(format, GetFramePath(output_path, frame->index, frame_count), frame->image, compression);
+                    });
+
+                    std::lock_guard lock(mutex);
+                    stats.encoding += elapsed;
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(mutex);
+                    if (!failure)
+                    {
+                        failure = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    auto finish = [&]()
+    {
+        queue.Close();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    };
+
+    // the iteration counts of the last frame rendered, for the next one to reuse
+    std::optional<Tensor<float, 2>> previous;
+    RenderParams previous_params;
+
+    try
+    {
+        for (size_t index = 0; index < frame_count && !failed; ++index)
+        {
+            RenderParams frame_params = params;
+            frame_params.zoom = GetFrameZoom(params.zoom, index, frame_count);
+            frame_params.center_on_pixel = true;
+
+            // only the first frame announces how it is computed, or the log would repeat it for every frame
+            auto [image, elapsed] = Time([&]()
+            {
+                size_t reused_pixels = 0;
+                auto mandelbrot = previous ? ComputeReprojected(pool, engine, *previous, previous_params, frame_params, lane_mode, tile_size, reused_pixels, false)
+                                           : Compute(pool, engine, frame_params, lane_mode, tile_size, true);
+                stats.reused_pixels += reused_pixels;
+
+                auto frame_image = Colorize(pool, mandelbrot, colormap, frame_params.max_iterations);
+                previous = std::move(mandelbrot);
+                previous_params = frame_params;
+                return frame_image;
+            });
+            stats.rendering += elapsed;
+            stats.total_pixels += params.height * params.width;
+
+            queue.Push({index, std::move(image)});
+        }
+    }
+    catch (...)
+    {
+        finish();
+        throw;
+    }
+
+    finish();
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    return stats;
+}
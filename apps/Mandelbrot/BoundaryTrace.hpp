@@ -0,0 +1,156 @@
+#pragma once
+
+#include <Tensor.hpp>
+
+#include "Mandelbrot.hpp"
+#include "Scheduler.hpp"
+
+#include <vector>
+
+/** @brief Render one tile of the image by boundary tracing.
+ *
+ * Every pixel on the edge of the tile is computed first. From there a pixel pulls its eight neighbors into the work list
+ * whenever it lies on the boundary between two regions of different iteration count. Escaped pixels are always treated
+ * as boundary pixels because their smooth shading differs from pixel to pixel, and so are pixels that merely ran out
+ * of iterations: escaped specks narrower than a pixel can sit among them, and only pixels proven to be inside the set
+ * (see Orbit) reliably enclose nothing but the set. Once the work list is empty, every pixel that was never reached is
+ * enclosed by proven interior pixels, and is filled without iterating.
+ *
+ * @tparam T The floating point type to iterate in.
+ * @param[out] mandelbrot The iteration buffer to write the tile into.
+ * @param[in] viewport The mapping from pixels to the complex plane.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @param[in] y_origin The first row of the tile.
+ * @param[in] x_origin The first column of the tile.
+ * @param[in] tile_height The height of the tile.
+ * @param[in] tile_width The width of the tile.
+ */
+template <typename T>
+auto BoundaryTraceTile(Tensor<float, 2>& mandelbrot, Viewport<T> const& viewport, size_t max_iterations,
+                       size_t y_origin, size_t x_origin, size_t tile_height, size_t tile_width) -> void
+{
+    // iteration count per pixel of the tile: -2 if never reached, -1 if waiting in the work list
+    static constexpr int32_t k_unreached = -2;
+    static constexpr int32_t k_queued = -1;
+
+    std::vector<int32_t> iterations(tile_height * tile_width, k_unreached);
+    std::vector<size_t> pending;
+
+    auto enqueue = [&](size_t y, size_t x)
+    {
+        size_t index = y * tile_width + x;
+        if (iterations[index] == k_unreached)
+        {
+            iterations[index] = k_queued;
+            pending.push_back(index);
+        }
+    };
+
+    // seed the work list with the edge of the tile
+    for (size_t x = 0; x < tile_width; ++x)
+    {
+        enqueue(0, x);
+        enqueue(tile_height - 1, x);
+    }
+    for (size_t y = 1; y + 1 < tile_height; ++y)
+    {
+        enqueue(y, 0);
+        enqueue(y, tile_width - 1);
+    }
+
+    while (!pending.empty())
+    {
+        size_t index = pending.back();
+        pending.pop_back();
+
+        size_t y = index / tile_width;
+        size_t x = index % tile_width;
+
+        // map the pixel coordinate to a point in the complex plane exactly as the per-pixel kernels do
+        size_t image_y = y_origin + y;
+        size_t image_x = x_origin + x;
+        T real = viewport.real_start + viewport.Column(image_x) * viewport.real_step;
+        T imag = viewport.imag_start + viewport.Row(image_y) * viewport.imag_step;
+
+        auto orbit = Iterate<T>({real, imag}, max_iterations);
+        mandelbrot({image_y, image_x}) = SmoothIteration(orbit.iteration, orbit.z, max_iterations);
+        iterations[index] = static_cast<int32_t>(orbit.iteration);
+
+        // gather the in-tile neighbors of the pixel, including diagonals so that escaped regions which only touch at
+        // a corner are still followed
+        size_t neighbors[8];
+        size_t neighbor_count = 0;
+        for (size_t neighbor_y = (y > 0 ? y - 1 : y); neighbor_y <= std::min(y + 1, tile_height - 1); ++neighbor_y)
+        {
+            for (size_t neighbor_x = (x > 0 ? x - 1 : x); neighbor_x <= std::min(x + 1, tile_width - 1); ++neighbor_x)
+            {
+                if (neighbor_y != y || neighbor_x != x)
+                {
+                    neighbors[neighbor_count++] = neighbor_y * tile_width + neighbor_x;
+                }
+            }
+        }
+
+        // a pixel is on a boundary if it was not proven to be inside the set, or if any computed neighbor has a
+        // different iteration count
+        bool boundary = !orbit.proven_interior;
+        for (size_t n = 0; n < neighbor_count && !boundary; ++n)
+        {
+            int32_t neighbor = iterations[neighbors[n]];
+            boundary = neighbor >= 0 && neighbor != iterations[index];
+        }
+
+        // follow the boundary by pulling in the neighbors of boundary pixels
+        if (boundary)
+        {
+            for (size_t n = 0; n < neighbor_count; ++n)
+            {
+                enqueue(neighbors[n] / tile_width, neighbors[n] % tile_width);
+            }
+        }
+    }
+
+    // whatever was never reached is enclosed by pixels inside the set
+    for (size_t y = 0; y < tile_height; ++y)
+    {
+        for (size_t x = 0; x < tile_width; ++x)
+        {
+            if (iterations[y * tile_width + x] == k_unreached)
+            {
+                mandelbrot({y_origin + y, x_origin + x}) = static_cast<float>(max_iterations);
+            }
+        }
+    }
+}
+
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set by boundary tracing.
+ *
+ * Produces the same image as MandelbrotGeneric() while only iterating pixels on region boundaries and outside the set.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] tile_size The side length of the tiles, which are processed independently and handed out to threads.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+auto MandelbrotBoundaryTrace(ThreadPool& pool, RenderParams const& params, size_t tile_size = k_default_tile_size) -> Tensor<float, 2>
+{
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
+
+    WithPrecision(params, [&](auto scalar)
+    {
+        auto viewport = GetViewport<decltype(scalar)>(params);
+
+        // trace every tile in parallel
+        DispatchTiles(pool, params.height, params.width, tile_size, [&](Tile const& image_tile)
+        {
+            size_t y_origin = image_tile.y_begin;
+            size_t x_origin = image_tile.x_begin;
+            size_t tile_height = image_tile.y_end - image_tile.y_begin;
+            size_t tile_width = image_tile.x_end - image_tile.x_begin;
+
+            BoundaryTraceTile(mandelbrot, viewport, params.max_iterations, y_origin, x_origin, tile_height, tile_width);
+        });
+    });
+
+    return mandelbrot;
+}
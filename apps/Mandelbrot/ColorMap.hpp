@@ -4,6 +4,8 @@
 #include "ColorMapData/Twilight.hpp"
 #include "ColorMapData/Viridis.hpp"
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <string>
 
@@ -14,38 +16,75 @@ enum class Colormap
     Viridis,
 };
 
-auto GetColormapByName(std::string const& name) -> Colormap
+/** @brief Look up a colormap by name without falling back to a default.
+ * @param[in] name The name of the colormap.
+ * @param[out] colormap The colormap, if the name was known.
+ * @returns Whether the name was known.
+ */
+auto FindColormapByName(std::string const& name, Colormap& colormap) -> bool
 {
     if (name == "magma")
     {
-        return Colormap::Magma;
+        colormap = Colormap::Magma;
     }
     else if (name == "twilight")
     {
-        return Colormap::Twilight;
+        colormap = Colormap::Twilight;
     }
     else if (name == "viridis")
     {
-        return Colormap::Viridis;
+        colormap = Colormap::Viridis;
     }
     else
+    {
+        return false;
+    }
+    return true;
+}
+
+auto GetColormapByName(std::string const& name) -> Colormap
+{
+    Colormap colormap = Colormap::Magma;
+    if (!FindColormapByName(name, colormap))
     {
         std::cerr << "no colormap (or invalid colormap) requested, defaulting to magma" << std::endl;
-        return Colormap::Magma;
     }
+    return colormap;
+}
+
+// palette entries packed as 0x00BBGGRR so a single 32-bit gather fetches a whole color, followed by a black entry at
+// k_interior_index for points that never escaped
+using PackedPalette = std::array<uint32_t, 257>;
+
+static constexpr int32_t k_interior_index = 256;
+
+constexpr auto PackPalette(Palette const& palette) -> PackedPalette
+{
+    PackedPalette packed{};
+    for (size_t index = 0; index < palette.size(); ++index)
+    {
+        auto [red, green, blue] = palette[index];
+        packed[index] = uint32_t(red) | (uint32_t(green) << 8) | (uint32_t(blue) << 16);
+    }
+
+    return packed;
 }
 
-auto GetColormapPalette(Colormap colormap) -> Palette
+inline constexpr PackedPalette magma256_packed = PackPalette(magma256);
+inline constexpr PackedPalette twilight256_packed = PackPalette(twilight256);
+inline constexpr PackedPalette viridis256_packed = PackPalette(viridis256);
+
+auto GetPackedPalette(Colormap colormap) -> PackedPalette const&
 {
     switch (colormap)
     {
     case Colormap::Magma:
-        return magma256;
+        return magma256_packed;
     case Colormap::Twilight:
-        return twilight256;
+        return twilight256_packed;
     case Colormap::Viridis:
-        return viridis256;
+        return viridis256_packed;
     default:
-        return magma256;
+        return magma256_packed;
     }
 }
@@ -2,7 +2,7 @@
 
 #include "Palette.hpp"
 
-Palette magma256 = {{
+inline constexpr Palette magma256 = {{
     {0, 0, 4},
     {1, 0, 5},
     {1, 1, 6},
@@ -1,3 +1,4 @@
 #include <array>
+#include <cstdint>
 
-using Palette = std::array<std::array<int, 3>, 256>;
+using Palette = std::array<std::array<uint8_t, 3>, 256>;
@@ -2,7 +2,7 @@
 
 #include "Palette.hpp"
 
-Palette twilight256 = {{
+inline constexpr Palette twilight256 = {{
     {226, 217, 226},
     {225, 217, 226},
     {224, 217, 226},
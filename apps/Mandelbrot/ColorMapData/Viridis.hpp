@@ -2,7 +2,7 @@
 
 #include "Palette.hpp"
 
-Palette viridis256 = {{
+inline constexpr Palette viridis256 = {{
     {68, 1, 84},
     {68, 2, 86},
     {69, 4, 87},
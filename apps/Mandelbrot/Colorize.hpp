@@ -0,0 +1,187 @@
+#pragma once
+
+#include <Tensor.hpp>
+
+#include "ColorMap.hpp"
+#include "InstructionSet.hpp"
+#include "Mandelbrot.hpp"
+#include "Scheduler.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+/*
+
+    colorizing is kept separate from computing the iteration counts so the same buffer can be shaded with any number
+    of palettes; the compute pass takes seconds, this pass takes milliseconds
+
+*/
+
+/** @brief Map a smoothed iteration count to an index into a PackedPalette.
+ * @param[in] value The smoothed iteration count (see SmoothIteration()).
+ * @param[in] max_iterations The iteration limit the buffer was computed with.
+ * @returns A palette index in range (0 - 255), or k_interior_index for points that never escaped (see PackedPalette).
+ */
+auto ColorizeIndex(float value, size_t max_iterations) -> int32_t
+{
+    float const limit = static_cast<float>(max_iterations);
+    if (value >= limit)
+    {
+        return k_interior_index;
+    }
+
+    // map normalized value in range (0.0 - 1.0) to a colormap index in range (0 - 255)
+    float normalized = value / limit;
+    return static_cast<int32_t>(std::clamp(normalized * 255.0f, 0.0f, 255.0f));
+}
+
+/** @brief Write a packed 0x00BBGGRR color into an interleaved RGB pixel.
+ * @param[out] pixel The 3 bytes to write the color into.
+ * @param[in] color The packed color (see PackedPalette).
+ */
+auto WritePackedColor(uint8_t* pixel, uint32_t color) -> void
+{
+    pixel[0] = static_cast<uint8_t>(color);
+    pixel[1] = static_cast<uint8_t>(color >> 8);
+    pixel[2] = static_cast<uint8_t>(color >> 16);
+}
+
+/** @brief Colorize a span of one row of an iteration buffer with a SIMD kernel.
+ *
+ * The palette indices are computed and the packed colors gathered a vector at a time; only the final 3-byte stores
+ * are done per pixel.
+ *
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @param[out] row The interleaved RGB row to write the span into.
+ * @param[in] mandelbrot The smoothed iteration counts to colorize.
+ * @param[in] palette The packed palette to use.
+ * @param[in] y The row to colorize.
+ * @param[in] x_begin The first column of the span.
+ * @param[in] x_end One past the last column of the span.
+ * @param[in] max_iterations The iteration limit the buffer was computed with.
+ */
+template <typename Simd>
+auto ColorizeRowSIMD(uint8_t* row, Tensor<float, 2> const& mandelbrot, PackedPalette const& palette, size_t y, size_t x_begin, size_t x_end, size_t max_iterations) -> void
+{
+    Simd::Run([&]()
+    {
+        using Vector = typename Simd::Vector;
+        using Mask = typename Simd::Mask;
+        using Counter = typename Simd::Counter;
+
+        static constexpr size_t k_width = Simd::k_width;
+
+        Vector v_max_iterations = Simd::Set1(static_cast<float>(max_iterations));
+        Vector v_scale = Simd::Set1(255.0f);
+        Counter vi_interior = Simd::CounterSet1(k_interior_index);
+
+        int32_t colors[k_width];
+
+        size_t x = x_begin;
+        for (; x + k_width <= x_end; x += k_width)
+        {
+            Vector v_value = Simd::Load(&mandelbrot({y, x}));
+
+            // same arithmetic as ColorizeIndex(), so both paths pick identical palette entries
+            Vector v_normalized = Simd::Div(v_value, v_max_iterations);
+            Vector v_clamped = Simd::Min(Simd::Max(Simd::Mul(v_normalized, v_scale), Simd::Zero()), v_scale);
+            Mask m_escaped = Simd::LessThan(v_value, v_max_iterations);
+            Counter vi_indices = Simd::Select(m_escaped, Simd::Truncate(v_clamped), vi_interior);
+            Simd::Store(colors, Simd::Gather(palette.data(), vi_indices));
+
+            for (size_t lane = 0; lane < k_width; ++lane)
+            {
+                WritePackedColor(row + (x + lane) * 3, static_cast<uint32_t>(colors[lane]));
+            }
+        }
+
+        // scalar tail for spans that are not a multiple of the vector width
+        for (; x < x_end; ++x)
+        {
+            WritePackedColor(row + x * 3, palette[ColorizeIndex(mandelbrot({y, x}), max_iterations)]);
+        }
+    });
+}
+
+/** @brief Colorize a span of one row of an iteration buffer one pixel at a time.
+ * @param[out] row The interleaved RGB row to write the span into.
+ * @param[in] mandelbrot The smoothed iteration counts to colorize.
+ * @param[in] palette The packed palette to use.
+ * @param[in] y The row to colorize.
+ * @param[in] x_begin The first column of the span.
+ * @param[in] x_end One past the last column of the span.
+ * @param[in] max_iterations The iteration limit the buffer was computed with.
+ */
+auto ColorizeRowGeneric(uint8_t* row, Tensor<float, 2> const& mandelbrot, PackedPalette const& palette, size_t y, size_t x_begin, size_t x_end, size_t max_iterations) -> void
+{
+    for (size_t x = x_begin; x < x_end; ++x)
+    {
+        WritePackedColor(row + x * 3, palette[ColorizeIndex(mandelbrot({y, x}), max_iterations)]);
+    }
+}
+
+/** @brief Map a buffer of smoothed iteration counts to colors, writing them into caller owned memory.
+ *
+ * Uses the widest SIMD kernel the binary was compiled with and the processor supports. The destination can be any
+ * buffer large enough for the image, such as a memory mapped output file, so no intermediate image is allocated.
+ *
+ * @param[in] pool The worker threads to colorize on.
+ * @param[in] mandelbrot The smoothed iteration counts to colorize, as produced by any of the Mandelbrot functions.
+ * @param[in] colormap The color palette to use.
+ * @param[in] max_iterations The iteration limit the buffer was computed with.
+ * @param[out] pixels The interleaved RGB image (height x width x 3 bytes, rows packed back to back) to write into.
+ */
+auto ColorizeInto(ThreadPool& pool, Tensor<float, 2> const& mandelbrot, Colormap colormap, size_t max_iterations, uint8_t* pixels) -> void
+{
+    auto [height, width] = mandelbrot.Shape();
+
+    // resolved once; the palettes are built at compile time
+    auto const& palette = GetPackedPalette(colormap);
+
+    // the instruction set is picked once rather than per row; wider instruction sets take precedence
+    auto colorize_row = &ColorizeRowGeneric;
+#if __SUPPORTS_SSE__
+    if (SupportsSSE())
+    {
+        colorize_row = &ColorizeRowSIMD<SimdSSE<float>>;
+    }
+#endif
+#if __SUPPORTS_AVX2__
+    if (SupportsAVX2())
+    {
+        colorize_row = &ColorizeRowSIMD<SimdAVX2<float>>;
+    }
+#endif
+#if __SUPPORTS_AVX512__
+    if (SupportsAVX512())
+    {
+        colorize_row = &ColorizeRowSIMD<SimdAVX512<float>>;
+    }
+#endif
+
+    DispatchTiles(pool, height, width, k_default_tile_size, [&](Tile const& tile)
+    {
+        for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+        {
+            colorize_row(pixels + y * width * 3, mandelbrot, palette, y, tile.x_begin, tile.x_end, max_iterations);
+        }
+    });
+}
+
+/** @brief Map a buffer of smoothed iteration counts to colors.
+ * @param[in] pool The worker threads to colorize on.
+ * @param[in] mandelbrot The smoothed iteration counts to colorize, as produced by any of the Mandelbrot functions.
+ * @param[in] colormap The color palette to use.
+ * @param[in] max_iterations The iteration limit the buffer was computed with.
+ * @returns A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ */
+auto Colorize(ThreadPool& pool, Tensor<float, 2> const& mandelbrot, Colormap colormap, size_t max_iterations) -> Tensor<uint8_t, 3>
+{
+    auto [height, width] = mandelbrot.Shape();
+    auto image = Tensor<uint8_t, 3>({height, width, 3});
+
+    ColorizeInto(pool, mandelbrot, colormap, max_iterations, &image({0, 0, 0}));
+
+    return image;
+}
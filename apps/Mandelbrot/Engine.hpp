@@ -0,0 +1,336 @@
+#pragma once
+
+#include <Expect.hpp>
+#include <Tensor.hpp>
+
+#include "BoundaryTrace.hpp"
+#include "ColorMap.hpp"
+#include "Colorize.hpp"
+#include "Mandelbrot.hpp"
+#include "Perturbation.hpp"
+#include "Scheduler.hpp"
+#include "Subdivide.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <string>
+
+// the coarsest pass of a progressive render samples every k_default_progressive_stride-th pixel in each direction
+static constexpr size_t k_default_progressive_stride = 8;
+
+// bands with no height given (such as those colorized straight into a mapped file) are this many rows of tiles tall,
+// which keeps every thread busy while the band's iteration counts stay a small fraction of the image's
+static constexpr size_t k_default_band_tiles = 4;
+
+enum class Engine
+{
+    BruteForce,    // every pixel is iterated with the widest supported kernel
+    Generic,       // every pixel is iterated with the scalar kernel
+    Subdivide,     // mariani-silver rectangle subdivision
+    BoundaryTrace, // boundary tracing with flood fill of the regions inside the set
+    Perturbation,  // deltas from a high precision reference orbit, for zooms past double precision
+};
+
+auto GetEngineByName(std::string const& name) -> Engine
+{
+    if (name == "brute")
+    {
+        return Engine::BruteForce;
+    }
+    else if (name == "generic")
+    {
+        return Engine::Generic;
+    }
+    else if (name == "subdivide")
+    {
+        return Engine::Subdivide;
+    }
+    else if (name == "trace")
+    {
+        return Engine::BoundaryTrace;
+    }
+    else if (name == "perturb")
+    {
+        return Engine::Perturbation;
+    }
+    else
+    {
+        std::cerr << "invalid engine requested, defaulting to brute" << std::endl;
+        return Engine::BruteForce;
+    }
+}
+
+/** @brief Get the engine that actually computes a view.
+ * @param[in] engine The rendering strategy requested.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @returns The engine, with brute force switched to perturbation past double precision.
+ */
+auto ResolveEngine(Engine engine, RenderParams const& params) -> Engine
+{
+    return engine == Engine::BruteForce && UsePerturbation(params) ? Engine::Perturbation : engine;
+}
+
+/** @brief Compute the state every part of an image shares, so renders split into bands, windows, or lattices only
+ * compute it once.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the image, or of any part of it.
+ * @returns The perturbation reference of the image (see ComputePerturbationReference()), or nothing for the engines that
+ *          need none.
+ */
+auto PrepareReference(Engine engine, RenderParams const& params) -> std::optional<PerturbationReference>
+{
+    if (ResolveEngine(engine, params) != Engine::Perturbation)
+    {
+        return std::nullopt;
+    }
+
+    return ComputePerturbationReference(params);
+}
+
+/** @brief Compute the smoothed iteration count of every pixel of part of an image with the given engine.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use; brute force switches to perturbation past double precision.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] reference The state shared by the image the render is part of (see PrepareReference()).
+ * @param[in] verbose Whether to print how the image is being computed.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts, ready to be passed to Colorize().
+ */
+auto ComputePart(ThreadPool& pool, Engine engine, RenderParams const& params, LaneMode lane_mode, size_t tile_size, std::optional<PerturbationReference> const& reference, bool verbose = true) -> Tensor<float, 2>
+{
+    auto announce = [&](char const* message)
+    {
+        if (verbose)
+        {
+            std::cout << message << std::endl;
+        }
+    };
+
+    if (ResolveEngine(engine, params) != engine)
+    {
+        announce("View is too deep for double precision, switching to perturbation.");
+        engine = Engine::Perturbation;
+    }
+
+    if (engine != Engine::Perturbation && UseDoublePrecision(params))
+    {
+        announce("Iterating in double precision.");
+    }
+
+    switch (engine)
+    {
+    case Engine::Generic:
+        announce("Running Mandelbrot with generic instruction set.");
+        return MandelbrotGeneric(pool, params, tile_size);
+    case Engine::Subdivide:
+        announce("Running Mandelbrot with rectangle subdivision.");
+        return MandelbrotSubdivide(pool, params, tile_size);
+    case Engine::BoundaryTrace:
+        announce("Running Mandelbrot with boundary tracing.");
+        return MandelbrotBoundaryTrace(pool, params, tile_size);
+    case Engine::Perturbation:
+        announce("Running Mandelbrot with perturbation.");
+        return reference ? MandelbrotPerturbation(pool, params, *reference, tile_size, verbose) : MandelbrotPerturbation(pool, params, tile_size, verbose);
+    case Engine::BruteForce:
+    default:
+        return Mandelbrot(pool, params, lane_mode, tile_size, verbose);
+    }
+}
+
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set with the given engine.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use; brute force switches to perturbation past double precision.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] verbose Whether to print how the image is being computed.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts, ready to be passed to Colorize().
+ */
+auto Compute(ThreadPool& pool, Engine engine, RenderParams const& params, LaneMode lane_mode, size_t tile_size, bool verbose = true) -> Tensor<float, 2>
+{
+    return ComputePart(pool, engine, params, lane_mode, tile_size, PrepareReference(engine, params), verbose);
+}
+
+/** @brief Generate a visualization of the Mandelbrot set with the given engine.
+ *
+ * Shorthand for Colorize(Compute(...)); callers that shade the same view with several palettes should call the two
+ * passes themselves and keep the iteration buffer.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] colormap The color palette to use.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] verbose Whether to print how the image is being computed.
+ * @returns A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ */
+auto Render(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, bool verbose = true) -> Tensor<uint8_t, 3>
+{
+    return Colorize(pool, Compute(pool, engine, params, lane_mode, tile_size, verbose), colormap, params.max_iterations);
+}
+
+/** @brief Compute the smoothed iteration counts of the Mandelbrot set one horizontal band at a time.
+ *
+ * Only one band is held in memory at once, so the peak memory use follows the band height instead of the image size.
+ * Every band maps its rows exactly like the whole image does, and shares its perturbation reference, so the bands
+ * match a single Compute() of it.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the whole image.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] band_height The number of rows per band.
+ * @param[in] consume The function every band is handed to, top to bottom, as
+ *                    consume(size_t first_row, Tensor<float, 2> const& band).
+ */
+template <typename Consumer>
+auto ComputeBands(ThreadPool& pool, Engine engine, RenderParams const& params, LaneMode lane_mode, size_t tile_size, size_t band_height, Consumer&& consume) -> void
+{
+    Expect(band_height > 0, "error: bands must be at least one row tall");
+
+    auto const reference = PrepareReference(engine, params);
+
+    for (size_t first_row = 0; first_row < params.height; first_row += band_height)
+    {
+        RenderParams band = params;
+        band.image_height = params.height;
+        band.first_row = first_row;
+        band.height = std::min(band_height, params.height - first_row);
+
+        // the engine is the same for every band, so it is only announced once
+        consume(first_row, ComputePart(pool, engine, band, lane_mode, tile_size, reference, first_row == 0));
+    }
+}
+
+/** @brief Generate a visualization of the Mandelbrot set one horizontal band at a time (see ComputeBands()).
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the whole image.
+ * @param[in] colormap The color palette to use.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] band_height The number of rows per band.
+ * @param[in] consume The function every band is handed to, top to bottom, as consume(Tensor<uint8_t, 3> const&).
+ */
+template <typename Consumer>
+auto RenderBands(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, size_t band_height, Consumer&& consume) -> void
+{
+    ComputeBands(pool, engine, params, lane_mode, tile_size, band_height, [&](size_t, Tensor<float, 2> const& band)
+    {
+        consume(Colorize(pool, band, colormap, params.max_iterations));
+    });
+}
+
+/** @brief Compute the lattice of every stride-th pixel of an image, starting at the given pixel, and copy it into its
+ * places in the image.
+ *
+ * The lattice maps its pixels exactly like the whole image does, so it matches those pixels of a single Compute() of it.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the whole image.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] reference The state shared by every part of the image (see PrepareReference()).
+ * @param[in] stride The spacing of the lattice in pixels.
+ * @param[in] row The row of the image the lattice starts at (less than stride).
+ * @param[in] column The column of the image the lattice starts at (less than stride).
+ * @param[out] mandelbrot The iteration buffer of the whole image to write the lattice into.
+ * @param[in] verbose Whether to print how the lattice is being computed.
+ */
+auto ComputeLattice(ThreadPool& pool, Engine engine, RenderParams const& params, LaneMode lane_mode, size_t tile_size, std::optional<PerturbationReference> const& reference, size_t stride, size_t row, size_t column, Tensor<float, 2>& mandelbrot, bool verbose = true) -> void
+{
+    if (row >= params.height || column >= params.width)
+    {
+        return; // the image is too small to hold any pixel of the lattice
+    }
+
+    RenderParams lattice = params;
+    lattice.image_height = params.height;
+    lattice.image_width = params.width;
+    lattice.height = (params.height - row + stride - 1) / stride;
+    lattice.width = (params.width - column + stride - 1) / stride;
+    lattice.sample_stride = stride;
+    lattice.sample_row = row;
+    lattice.sample_column = column;
+
+    auto part = ComputePart(pool, engine, lattice, lane_mode, tile_size, reference, verbose);
+
+    DispatchTiles(pool, lattice.height, lattice.width, k_default_tile_size, [&](Tile const& tile)
+    {
+        for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+        {
+            for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+            {
+                mandelbrot({row + y * stride, column + x * stride}) = part({y, x});
+            }
+        }
+    });
+}
+
+/** @brief Compute the smoothed iteration counts of the Mandelbrot set coarse to fine, for quick previews.
+ *
+ * The first pass computes every coarsest_stride-th pixel in each direction; every later pass halves the stride and
+ * only computes the pixels between the ones already known, so the passes add up to a single Compute() of the image
+ * (the subdivision engine fills a few rectangles differently). Each pass is handed to the caller as soon as it is done, as a smaller image of every stride-th pixel.
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The size, view, and iteration limit of the image.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] coarsest_stride The pixel spacing of the first pass; a power of two.
+ * @param[in] consume The function every pass is handed to, coarsest first, as
+ *                    consume(size_t stride, Tensor<float, 2> const& pass); the last pass has a stride of 1.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts, the same as the last pass.
+ */
+template <typename Consumer>
+auto ComputeProgressive(ThreadPool& pool, Engine engine, RenderParams const& params, LaneMode lane_mode, size_t tile_size, size_t coarsest_stride, Consumer&& consume) -> Tensor<float, 2>
+{
+    Expect(coarsest_stride > 0 && (coarsest_stride & (coarsest_stride - 1)) == 0, "error: the coarsest progressive pass must sample every 2^k-th pixel");
+
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
+    auto const reference = PrepareReference(engine, params);
+
+    for (size_t stride = coarsest_stride;; stride /= 2)
+    {
+        if (stride == coarsest_stride)
+        {
+            ComputeLattice(pool, engine, params, lane_mode, tile_size, reference, stride, 0, 0, mandelbrot);
+        }
+        else
+        {
+            // the pixels of this pass that the last one lacks form three lattices of twice the stride; the engine is
+            // only announced by the first pass
+            ComputeLattice(pool, engine, params, lane_mode, tile_size, reference, 2 * stride, 0, stride, mandelbrot, false);
+            ComputeLattice(pool, engine, params, lane_mode, tile_size, reference, 2 * stride, stride, 0, mandelbrot, false);
+            ComputeLattice(pool, engine, params, lane_mode, tile_size, reference, 2 * stride, stride, stride, mandelbrot, false);
+        }
+
+        if (stride == 1)
+        {
+            consume(stride, mandelbrot);
+            return mandelbrot;
+        }
+
+        auto pass = Tensor<float, 2>({(params.height + stride - 1) / stride, (params.width + stride - 1) / stride});
+        auto [pass_height, pass_width] = pass.Shape();
+
+        DispatchTiles(pool, pass_height, pass_width, k_default_tile_size, [&](Tile const& tile)
+        {
+            for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+            {
+                for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+                {
+                    pass({y, x}) = mandelbrot({y * stride, x * stride});
+                }
+            }
+        });
+
+        consume(stride, pass);
+    }
+}
@@ -11,6 +11,40 @@
 #define __SUPPORTS_SSE__ 0
 #endif
 
+// the avx2 and avx-512 kernels are compiled into every x86 binary and picked at runtime: gcc and clang compile just the
+// kernels for those instruction sets (see the target regions below) while the rest of the binary stays portable, and
+// msvc emits any intrinsic without being asked
+#if __SUPPORTS_SSE__ && (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && defined(_M_X64)))
+#define __SUPPORTS_AVX2__ 1
+#define __SUPPORTS_AVX512__ 1
+#else
+#define __SUPPORTS_AVX2__ 0
+#define __SUPPORTS_AVX512__ 0
+#endif
+
+// functions defined between __BEGIN_AVX2_TARGET__ (or __BEGIN_AVX512_TARGET__) and __END_TARGET__ may use that
+// instruction set whatever the compiler flags are; they must only run once SupportsAVX2() (or SupportsAVX512()) holds
+#if defined(__clang__)
+#define __BEGIN_AVX2_TARGET__ _Pragma("clang attribute push (__attribute__((target(\"avx2,fma\"))), apply_to = function)")
+#define __BEGIN_AVX512_TARGET__ _Pragma("clang attribute push (__attribute__((target(\"avx512f,avx2,fma\"))), apply_to = function)")
+#define __END_TARGET__ _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define __BEGIN_AVX2_TARGET__ _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define __BEGIN_AVX512_TARGET__ _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,avx2,fma\")")
+#define __END_TARGET__ _Pragma("GCC pop_options")
+#else
+#define __BEGIN_AVX2_TARGET__
+#define __BEGIN_AVX512_TARGET__
+#define __END_TARGET__
+#endif
+
+// inlines every call made by a function, and every call made by those, into it
+#if defined(__GNUC__) || defined(__clang__)
+#define __FLATTEN__ __attribute__((flatten))
+#else
+#define __FLATTEN__
+#endif
+
 #if defined(__ARM_NEON) || defined(__ARM_NEON__) || \
     (defined(_M_ARM64) || defined(__aarch64__))
 #define __SUPPORTS_NEON__ 1
@@ -23,7 +57,9 @@
 #include <sys/sysctl.h>
 #include <unistd.h>
 
-#if __SUPPORTS_SSE__
+#if __SUPPORTS_AVX2__ || __SUPPORTS_AVX512__
+#include <immintrin.h>
+#elif __SUPPORTS_SSE__
 #include <emmintrin.h>
 #endif
 
@@ -35,6 +71,24 @@ bool SupportsSSE_Apple()
     return (cpu_type == 7);
 }
 
+bool SupportsAVX2_Apple()
+{
+    int has_avx2 = 0;
+    int has_fma = 0;
+    size_t size = sizeof(int);
+    sysctlbyname("hw.optional.avx2_0", &has_avx2, &size, nullptr, 0);
+    sysctlbyname("hw.optional.fma", &has_fma, &size, nullptr, 0);
+    return has_avx2 && has_fma;
+}
+
+bool SupportsAVX512_Apple()
+{
+    int has_avx512f = 0;
+    size_t size = sizeof(has_avx512f);
+    sysctlbyname("hw.optional.avx512f", &has_avx512f, &size, nullptr, 0);
+    return has_avx512f;
+}
+
 bool SupportsNEON_Apple()
 {
     int cpu_type;
@@ -46,10 +100,13 @@ bool SupportsNEON_Apple()
 #elif defined(__linux__)
 
 #include <fcntl.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
-#if __SUPPORTS_SSE__
+#if __SUPPORTS_AVX2__ || __SUPPORTS_AVX512__
+#include <immintrin.h>
+#elif __SUPPORTS_SSE__
 #include <emmintrin.h>
 #elif __SUPPORTS_NEON__
 #include <arm_neon.h>
@@ -79,6 +136,54 @@ bool SupportsSSE_Linux()
     return has_sse;
 }
 
+bool SupportsAVX2_Linux()
+{
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (!cpuinfo)
+    {
+        return false;
+    }
+
+    char line[4096];
+    bool has_avx2 = false;
+
+    while (fgets(line, sizeof(line), cpuinfo) != nullptr)
+    {
+        if (strncmp(line, "flags", 5) == 0)
+        {
+            has_avx2 = (strstr(line, " avx2 ") != nullptr) && (strstr(line, " fma ") != nullptr);
+            break;
+        }
+    }
+
+    fclose(cpuinfo);
+    return has_avx2;
+}
+
+bool SupportsAVX512_Linux()
+{
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (!cpuinfo)
+    {
+        return false;
+    }
+
+    char line[4096];
+    bool has_avx512 = false;
+
+    while (fgets(line, sizeof(line), cpuinfo) != nullptr)
+    {
+        if (strncmp(line, "flags", 5) == 0)
+        {
+            has_avx512 = (strstr(line, " avx512f ") != nullptr);
+            break;
+        }
+    }
+
+    fclose(cpuinfo);
+    return has_avx512;
+}
+
 bool SupportsNEON_Linux()
 {
     FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
@@ -105,6 +210,9 @@ bool SupportsNEON_Linux()
 
 #elif defined(_WIN32)
 
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <intrin.h>
 #include <windows.h>
 
@@ -115,6 +223,47 @@ bool SupportsSSE_Windows()
     return (cpuInfo[3] & (1 << 25)) != 0;
 }
 
+bool SupportsAVX2_Windows()
+{
+    int cpuInfo[4] = {0};
+    __cpuid(cpuInfo, 1);
+    bool has_fma = (cpuInfo[2] & (1 << 12)) != 0;
+    bool has_osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    if (!has_fma || !has_osxsave)
+    {
+        return false;
+    }
+
+    // the os must also save the upper halves of the ymm registers on context switches
+    if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+}
+
+bool SupportsAVX512_Windows()
+{
+    int cpuInfo[4] = {0};
+    __cpuid(cpuInfo, 1);
+    bool has_osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    if (!has_osxsave)
+    {
+        return false;
+    }
+
+    // the os must also save the opmask and zmm registers on context switches
+    if ((_xgetbv(0) & 0xe6) != 0xe6)
+    {
+        return false;
+    }
+
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 16)) != 0;
+}
+
 bool SupportsNEON_Windows()
 {
     SYSTEM_INFO sysInfo;
@@ -124,28 +273,76 @@ bool SupportsNEON_Windows()
 
 #endif
 
+// the processor is only probed on the first call (on linux that means parsing /proc/cpuinfo); the kernels ask again
+// for every render, row dispatch, and colorization
 bool SupportsSSE()
 {
+    static bool const supported = []()
+    {
+#if defined(__APPLE__)
+        return SupportsSSE_Apple();
+#elif defined(__linux__)
+        return SupportsSSE_Linux();
+#elif defined(_WIN32)
+        return SupportsSSE_Windows();
+#else
+        return false;
+#endif
+    }();
+
+    return supported;
+}
+
+bool SupportsAVX2()
+{
+    static bool const supported = []()
+    {
 #if defined(__APPLE__)
-    return SupportsSSE_Apple();
+        return SupportsAVX2_Apple();
 #elif defined(__linux__)
-    return SupportsSSE_Linux();
+        return SupportsAVX2_Linux();
 #elif defined(_WIN32)
-    return SupportsSSE_Windows();
+        return SupportsAVX2_Windows();
 #else
-    return false;
+        return false;
 #endif
+    }();
+
+    return supported;
+}
+
+bool SupportsAVX512()
+{
+    static bool const supported = []()
+    {
+#if defined(__APPLE__)
+        return SupportsAVX512_Apple();
+#elif defined(__linux__)
+        return SupportsAVX512_Linux();
+#elif defined(_WIN32)
+        return SupportsAVX512_Windows();
+#else
+        return false;
+#endif
+    }();
+
+    return supported;
 }
 
 bool SupportsNEON()
 {
+    static bool const supported = []()
+    {
 #if defined(__APPLE__)
-    return SupportsNEON_Apple();
+        return SupportsNEON_Apple();
 #elif defined(__linux__)
-    return SupportsNEON_Linux();
+        return SupportsNEON_Linux();
 #elif defined(_WIN32)
-    return SupportsNEON_Windows();
+        return SupportsNEON_Windows();
 #else
-    return false;
+        return false;
 #endif
+    }();
+
+    return supported;
 }
@@ -1,283 +1,851 @@
 #pragma once
 
-#include <Dispatch.hpp>
 #include <Tensor.hpp>
 
-#include "ColorMap.hpp"
 #include "InstructionSet.hpp"
+#include "RenderParams.hpp"
+#include "Scheduler.hpp"
+#include "Simd.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <complex>
-
-static constexpr size_t k_max_iterations = 100;
-
-// bounds of the complex plane to visualize
-static constexpr float k_real_start = -2.5f;
-static constexpr float k_real_stop = 1.0f;
-static constexpr float k_imag_start = -1.0f;
-static constexpr float k_imag_stop = 1.0f;
+#include <iostream>
+#include <string>
+#include <type_traits>
 
 static constexpr float k_bailout_radius = 256.0f;
 static constexpr float k_bailout_radius_squared = k_bailout_radius * k_bailout_radius;
 
-/** @brief Generate a visualization of the Mandelbrot set using the given color palette.
- * @param[in] height The height of the output image.
- * @param[in] width The width of the output image.
- * @param[in] colormap The color palette to use.
- * @returns A 3D tensor (height x width x 3) representing an interleaved RGB image.
+// an orbit that returns this close to a previously saved value is treated as periodic (and therefore never escaping);
+// a few dozen ulps of the scalar type at the magnitude of the orbit
+template <typename T>
+static constexpr T k_periodicity_epsilon = std::is_same_v<T, double> ? T(1e-14) : T(1e-6);
+
+template <typename T>
+static constexpr T k_periodicity_epsilon_squared = k_periodicity_epsilon<T> * k_periodicity_epsilon<T>;
+
+// number of independent vectors the simd kernels iterate together by default
+static constexpr size_t k_default_unroll = 2;
+
+// side length of the square tiles that are handed out to threads by default
+static constexpr size_t k_default_tile_size = 64;
+
+// how the simd kernels assign pixels to vector lanes
+enum class LaneMode
+{
+    Grouped, // each group of pixels is iterated until its slowest lane finishes
+    Refill,  // finished lanes are immediately reloaded with the next pending pixel
+};
+
+auto GetLaneModeByName(std::string const& name) -> LaneMode
+{
+    if (name == "grouped")
+    {
+        return LaneMode::Grouped;
+    }
+    else if (name == "refill")
+    {
+        return LaneMode::Refill;
+    }
+    else
+    {
+        std::cerr << "invalid lane mode requested, defaulting to grouped" << std::endl;
+        return LaneMode::Grouped;
+    }
+}
+
+/** @brief Check whether a point lies in the main cardioid or the period-2 bulb of the Mandelbrot set.
+ *
+ * Both regions have closed-form boundaries, so points inside them can be colored as never escaping without iterating.
+ *
+ * @tparam T The floating point type to test in.
+ * @param[in] real The real component of the point.
+ * @param[in] imag The imaginary component of the point.
+ * @returns True if the point is inside either region.
  */
-auto MandelbrotGeneric(size_t height, size_t width, Colormap colormap) -> Tensor<uint8_t, 3>
+template <typename T>
+auto InCardioidOrBulb(T real, T imag) -> bool
 {
-    auto mandelbrot = Tensor<uint8_t, 3>({height, width, 3});
+    T imag_sq = imag * imag;
 
-    // apply the following operation to every pixel in the image
-    DispatchElement(height, width, [&](size_t y, size_t x)
+    // main cardioid: q * (q + (x - 1/4)) <= y^2 / 4, where q = (x - 1/4)^2 + y^2
+    T shifted = real - T(0.25);
+    T q = shifted * shifted + imag_sq;
+    if (q * (q + shifted) <= T(0.25) * imag_sq)
     {
-        // map the pixel coordinate to a point in the complex plane
-        float real = k_real_start + (static_cast<float>(x) / (width - 1)) * (k_real_stop - k_real_start);
-        float imag = k_imag_start + (static_cast<float>(y) / (height - 1)) * (k_imag_stop - k_imag_start);
+        return true;
+    }
+
+    // period-2 bulb: circle of radius 1/4 centered at -1
+    T bulb = real + T(1.0);
+    return bulb * bulb + imag_sq <= T(0.0625);
+}
+
+/** @brief Vectorized form of InCardioidOrBulb().
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @returns A mask of the lanes that lie outside both the main cardioid and the period-2 bulb.
+ */
+template <typename Simd>
+auto OutsideCardioidAndBulb(typename Simd::Vector real, typename Simd::Vector imag) -> typename Simd::Mask
+{
+    using Vector = typename Simd::Vector;
+
+    Vector imag_sq = Simd::Mul(imag, imag);
+
+    Vector shifted = Simd::Sub(real, Simd::Set1(0.25f));
+    Vector q = Simd::MulAdd(shifted, shifted, imag_sq);
+    auto outside_cardioid = Simd::LessThan(Simd::Mul(Simd::Set1(0.25f), imag_sq), Simd::Mul(q, Simd::Add(q, shifted)));
+
+    Vector bulb = Simd::Add(real, Simd::Set1(1.0f));
+    auto outside_bulb = Simd::LessThan(Simd::Set1(0.0625f), Simd::MulAdd(bulb, bulb, imag_sq));
+
+    return Simd::And(outside_cardioid, outside_bulb);
+}
+
+/** @brief Convert the escape iteration of a pixel into a continuous (smoothed) iteration count.
+ *
+ * The fractional part removes the banding that integer iteration counts produce once they are mapped to colors.
+ *
+ * @tparam T The floating point type the point was iterated in.
+ * @param[in] iteration The number of iterations run before the point escaped (or the maximum if it never did).
+ * @param[in] z The final value of z for the point.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @returns The smoothed iteration count, or exactly max_iterations for points that never escaped.
+ */
+template <typename T>
+auto SmoothIteration(size_t iteration, std::complex<T> z, size_t max_iterations) -> float
+{
+    if (iteration >= max_iterations)
+    {
+        return static_cast<float>(max_iterations);
+    }
+
+    // apply smoothing to reduce banding
+    T nu = std::log(std::log(std::abs(z))) / std::log(T(2.0));
+    return static_cast<float>(static_cast<T>(iteration + 1) - nu);
+}
+
+/** @brief Vectorized form of SmoothIteration().
+ *
+ * Uses FastLog2() in place of the natural logarithms, which moves the result by at most a few 1e-6 of an iteration.
+ *
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @param[in] iterations The number of iterations run before each lane escaped (or the maximum if it never did).
+ * @param[in] z_real The real component of the final value of z for each lane.
+ * @param[in] z_imag The imaginary component of the final value of z for each lane.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @returns The smoothed iteration count of each lane, or exactly max_iterations for lanes that never escaped.
+ */
+template <typename Simd>
+auto SmoothIterationSIMD(typename Simd::Counter iterations, typename Simd::Vector z_real, typename Simd::Vector z_imag, size_t max_iterations) -> typename Simd::Vector
+{
+    using Vector = typename Simd::Vector;
+
+    Vector v_max_iterations = Simd::Set1(static_cast<float>(max_iterations));
+
+    // nu = log2(ln(|z|)) = log2(log2(|z|^2) * ln(2) / 2)
+    Vector v_magnitude_sq = Simd::MulAdd(z_real, z_real, Simd::Mul(z_imag, z_imag));
+    Vector v_nu = FastLog2<Simd>(Simd::Mul(FastLog2<Simd>(v_magnitude_sq), Simd::Set1(0.34657359f)));
+    Vector v_smooth = Simd::Sub(Simd::Add(Simd::ToFloat(iterations), Simd::Set1(1.0f)), v_nu);
+
+    // lanes that never escaped have a meaningless nu
+    auto m_escaped = Simd::LessThan(iterations, static_cast<int32_t>(max_iterations));
+    return Simd::Select(m_escaped, v_smooth, v_max_iterations);
+}
+
+// the result of iterating a single point
+template <typename T>
+struct Orbit
+{
+    size_t iteration;      // iterations run before the point escaped, or the maximum if it never did
+    std::complex<T> z;     // final value of z
+    bool proven_interior;  // the point lies in the cardioid/bulb or has a periodic orbit, rather than merely running out of iterations
+};
+
+/** @brief Iterate the Mandelbrot function for a single point.
+ * @tparam T The floating point type to iterate in.
+ * @tparam MaxIterations The iteration limit baked into this instantiation, or k_dynamic_iterations.
+ * @param[in] c The point in the complex plane.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @returns The iteration count and final z of the point, and whether it was proven to be inside the set.
+ */
+template <typename T, size_t MaxIterations = k_dynamic_iterations>
+auto Iterate(std::complex<T> c, size_t max_iterations) -> Orbit<T>
+{
+    size_t const limit = IterationLimit<MaxIterations>(max_iterations);
+
+    std::complex<T> z(0, 0);
+
+    // points inside the main cardioid or period-2 bulb never escape, so skip straight to the maximum
+    if (InCardioidOrBulb(c.real(), c.imag()))
+    {
+        return {limit, z, true};
+    }
 
-        std::complex<float> c(real, imag);
-        std::complex<float> z(0.0f, 0.0f);
+    size_t iteration = 0;
 
-        size_t iteration = 0;
+    // brent-style periodicity check: z is saved at power of two iterations and compared against every new value
+    std::complex<T> saved(0, 0);
+    size_t next_save = 1;
 
-        // iterate the mandelbrot function until the point escapes or the maximum number of iterations is reached
-        while (std::abs(z) < k_bailout_radius && iteration < k_max_iterations)
+    // iterate the mandelbrot function until the point escapes or the maximum number of iterations is reached
+    while (std::abs(z) < T(k_bailout_radius) && iteration < limit)
+    {
+        z = z * z + c;
+        ++iteration;
+
+        // an orbit that revisits a saved value is cyclic and will never escape
+        if (std::norm(z - saved) < k_periodicity_epsilon_squared<T>)
         {
-            z = z * z + c;
-            ++iteration;
+            return {limit, z, true};
         }
 
-        if (iteration < k_max_iterations) // points that escape are colored based on the number of iterations it took to escape
+        if (iteration == next_save)
         {
-            // apply smoothing to reduce banding
-            float nu = std::log(std::log(std::abs(z))) / std::log(2.0f);
-            float normalized = (iteration + 1 - nu) / k_max_iterations;
+            saved = z;
+            next_save *= 2;
+        }
+    }
 
-            // map normalized value in range (0.0 - 1.0) to a colormap index in range (0 - 255)
-            size_t index = std::clamp(static_cast<size_t>(normalized * 255.0f), size_t(0), size_t(255));
+    return {iteration, z, false};
+}
 
-            // get the corresponding RGB value from the palette
-            auto [red, green, blue] = GetColormapPalette(colormap)[index];
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set.
+ *
+ * Iterates in double precision when the pixel spacing is too fine for float (see UseDoublePrecision()).
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+auto MandelbrotGeneric(ThreadPool& pool, RenderParams const& params, size_t tile_size = k_default_tile_size) -> Tensor<float, 2>
+{
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
 
-            mandelbrot({y, x, 0}) = red;
-            mandelbrot({y, x, 1}) = green;
-            mandelbrot({y, x, 2}) = blue;
-        }
-        else // points that do not escape are colored black
+    WithPrecision(params, [&](auto scalar)
+    {
+        using T = decltype(scalar);
+        auto viewport = GetViewport<T>(params);
+
+        WithIterationLimit(params.max_iterations, [&](auto max_iterations_constant)
         {
-            mandelbrot({y, x, 0}) = 0;
-            mandelbrot({y, x, 1}) = 0;
-            mandelbrot({y, x, 2}) = 0;
-        }
+            static constexpr size_t MaxIterations = decltype(max_iterations_constant)::value;
+
+            // apply the following operation to every pixel in the image
+            DispatchTiles(pool, params.height, params.width, tile_size, [&](Tile const& tile)
+            {
+                for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+                {
+                    for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+                    {
+                        // map the pixel coordinate to a point in the complex plane
+                        T real = viewport.real_start + viewport.Column(x) * viewport.real_step;
+                        T imag = viewport.imag_start + viewport.Row(y) * viewport.imag_step;
+
+                        auto orbit = Iterate<T, MaxIterations>({real, imag}, params.max_iterations);
+
+                        mandelbrot({y, x}) = SmoothIteration(orbit.iteration, orbit.z, params.max_iterations);
+                    }
+                }
+            });
+        });
     });
 
     return mandelbrot;
 }
 
-auto MandelbrotSSE(size_t height, size_t width, Colormap colormap) -> Tensor<uint8_t, 3>
+/** @brief Iterate Unroll vectors of points with a SIMD kernel until every lane has escaped or reached the limit.
+ *
+ * The vectors are iterated in the same loop so the out-of-order core can overlap the multiply/add latency of one
+ * vector with the arithmetic of the others; the loop runs until the slowest lane is done.
+ *
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @tparam Unroll The number of independent vectors to interleave.
+ * @tparam MaxIterations The iteration limit baked into this instantiation, or k_dynamic_iterations.
+ * @param[in] v_c_real The real components of the points.
+ * @param[in] v_c_imag The imaginary components of the points.
+ * @param[in] m_valid The lanes that hold a point; the others are left alone.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @param[out] vi_iterations The number of iterations run before each lane escaped (or the maximum if it never did).
+ * @param[out] v_z_real The real components of the final values of z.
+ * @param[out] v_z_imag The imaginary components of the final values of z.
+ */
+template <typename Simd, size_t Unroll, size_t MaxIterations>
+auto IterateSIMD(typename Simd::Vector const (&v_c_real)[Unroll], typename Simd::Vector const (&v_c_imag)[Unroll], typename Simd::Mask const (&m_valid)[Unroll], size_t max_iterations,
+                 typename Simd::Counter (&vi_iterations)[Unroll], typename Simd::Vector (&v_z_real)[Unroll], typename Simd::Vector (&v_z_imag)[Unroll]) -> void
 {
-#if __SUPPORTS_SSE__
-    auto mandelbrot = Tensor<uint8_t, 3>({height, width, 3});
+    using Scalar = typename Simd::Scalar;
+    using Vector = typename Simd::Vector;
+    using Mask = typename Simd::Mask;
+    using Counter = typename Simd::Counter;
+
+    size_t const limit = IterationLimit<MaxIterations>(max_iterations);
+
+    Vector v_bailout_sq = Simd::Set1(k_bailout_radius_squared);
 
-    // apply the following operation to every row in the image
-    DispatchRow(height, [&](size_t y)
+    Vector v_saved_real[Unroll];
+    Vector v_saved_imag[Unroll];
+    Mask m_active[Unroll];
+
+    for (size_t u = 0; u < Unroll; ++u)
     {
-        // compute imaginary component for current row
-        float imag = k_imag_start + (static_cast<float>(y) / (height - 1)) * (k_imag_stop - k_imag_start);
+        // initialize z to (0+0i) for each pixel
+        v_z_real[u] = Simd::Zero();
+        v_z_imag[u] = Simd::Zero();
+
+        // orbit value saved for the periodicity check
+        v_saved_real[u] = Simd::Zero();
+        v_saved_imag[u] = Simd::Zero();
+
+        // lanes inside the main cardioid or period-2 bulb never escape; they start at the maximum iteration count
+        // and inactive, as do lanes that hold no point
+        Mask m_outside = OutsideCardioidAndBulb<Simd>(v_c_real[u], v_c_imag[u]);
+        vi_iterations[u] = Simd::Select(m_outside, Simd::CounterZero(), Simd::CounterSet1(static_cast<int32_t>(limit)));
+        m_active[u] = Simd::And(m_outside, m_valid[u]);
+    }
+
+    /*
 
-        // process pixels in chunks of four
-        for (size_t x_start = 0; x_start < width - (width % 4); x_start += 4)
+        iterate Mandelbrot formula until all lanes have either diverged or reached the maximum iteration count
+        emulates the following sequential code for every lane:
+
+        while (std::abs(z) < k_bailout_radius && iteration < limit)
         {
-            // compute real component for current set of four pixels
-            // float real[i] = k_real_start + (static_cast<float>(x[i]) / (width - 1)) * (k_real_stop - k_real_start);
-            __m128 v_real_start = _mm_set1_ps(k_real_start);
-            __m128 v_real_stop = _mm_set1_ps(k_real_stop);
-            __m128 v_real_range = _mm_sub_ps(v_real_stop, v_real_start);
-            __m128 v_width_minus_one = _mm_set1_ps(static_cast<float>(width - 1));
-            __m128 v_indices = _mm_setr_ps(static_cast<float>(x_start + 0),
-                                           static_cast<float>(x_start + 1),
-                                           static_cast<float>(x_start + 2),
-                                           static_cast<float>(x_start + 3));
-            __m128 v_ratio = _mm_div_ps(v_indices, v_width_minus_one);
-            __m128 v_c_real = _mm_add_ps(v_real_start, _mm_mul_ps(v_ratio, v_real_range));
-
-            // set imaginary component of c to constant value for current row
-            __m128 v_c_imag = _mm_set1_ps(imag);
-
-            // initialize z to (0+0i) for each pixel
-            __m128 v_z_real = _mm_setzero_ps();
-            __m128 v_z_imag = _mm_setzero_ps();
-
-            // initialize iteration counts to 0 and set maximum iterations
-            __m128i vi_iterations = _mm_setzero_si128();
-            __m128i vi_max_iters = _mm_set1_epi32(k_max_iterations);
-
-            // set bailout squared threshold
-            __m128 v_bailout_sq = _mm_set1_ps(k_bailout_radius_squared);
-
-            // set constant 2 for later use in Mandelbrot calculations
-            __m128 v_two = _mm_set1_ps(2.0f);
-
-            /*
-
-                iterate Mandelbrot formula until all lanes have either diverged or reached the maximum iteration count
-                emulates the following sequential code:
-
-                while (std::abs(z) < k_bailout_radius && iteration < k_max_iterations)
-                {
-                    z = z * z + c;
-                    ++iteration;
-                }
+            z = z * z + c;
+            ++iteration;
+        }
+
+        every lane that is still active has run exactly as many iterations as the loop itself, so the maximum
+        iteration check is the scalar loop bound, and the brent periodicity check can save z for every lane at
+        the same power of two iterations
 
-            */
+    */
 
-            while (true)
+    Vector v_epsilon_sq = Simd::Set1(k_periodicity_epsilon_squared<Scalar>);
+    Counter vi_max_iterations = Simd::CounterSet1(static_cast<int32_t>(limit));
+
+    size_t next_save = 1;
+
+    for (size_t iteration = 0; iteration < limit; ++iteration)
+    {
+        bool save = (iteration + 1 == next_save);
+        bool any_active = false;
+
+        // the compiler fully unrolls this loop, leaving Unroll independent dependency chains per iteration
+        for (size_t u = 0; u < Unroll; ++u)
+        {
+            Vector v_z_real_sq = Simd::Mul(v_z_real[u], v_z_real[u]);
+            Vector v_z_imag_sq = Simd::Mul(v_z_imag[u], v_z_imag[u]);
+            Vector v_z_magnitude = Simd::Add(v_z_real_sq, v_z_imag_sq);
+
+            // retire lanes whose magnitude reached the bailout
+            m_active[u] = Simd::And(m_active[u], Simd::LessThan(v_z_magnitude, v_bailout_sq));
+            any_active |= Simd::Any(m_active[u]);
+
+            // increment iteration counts for active lanes
+            vi_iterations[u] = Simd::Increment(vi_iterations[u], m_active[u]);
+
+            // compute new z values using Mandelbrot formula: z = z^2 + c
+            Vector v_new_z_real = Simd::Add(Simd::Sub(v_z_real_sq, v_z_imag_sq), v_c_real[u]);
+            Vector v_new_z_imag = Simd::MulAdd(Simd::Add(v_z_real[u], v_z_real[u]), v_z_imag[u], v_c_imag[u]);
+
+            // update z values only for lanes that are still active
+            v_z_real[u] = Simd::Select(m_active[u], v_new_z_real, v_z_real[u]);
+            v_z_imag[u] = Simd::Select(m_active[u], v_new_z_imag, v_z_imag[u]);
+
+            // lanes whose orbit revisited the saved value are cyclic; retire them at the maximum iteration count
+            Vector v_delta_real = Simd::Sub(v_z_real[u], v_saved_real[u]);
+            Vector v_delta_imag = Simd::Sub(v_z_imag[u], v_saved_imag[u]);
+            Vector v_delta_sq = Simd::MulAdd(v_delta_real, v_delta_real, Simd::Mul(v_delta_imag, v_delta_imag));
+            Mask m_periodic = Simd::And(m_active[u], Simd::LessThan(v_delta_sq, v_epsilon_sq));
+            vi_iterations[u] = Simd::Select(m_periodic, vi_max_iterations, vi_iterations[u]);
+            m_active[u] = Simd::AndNot(m_active[u], m_periodic);
+
+            if (save)
             {
-                __m128 v_z_real_sq = _mm_mul_ps(v_z_real, v_z_real);
-                __m128 v_z_imag_sq = _mm_mul_ps(v_z_imag, v_z_imag);
-                __m128 v_z_magnitude = _mm_add_ps(v_z_real_sq, v_z_imag_sq);
+                v_saved_real[u] = v_z_real[u];
+                v_saved_imag[u] = v_z_imag[u];
+            }
+        }
+
+        if (!any_active)
+        {
+            break;
+        }
 
-                // determine lanes where magnitude is less than bailout
-                __m128 v_within_bailout = _mm_cmplt_ps(v_z_magnitude, v_bailout_sq);
+        if (save)
+        {
+            next_save *= 2;
+        }
+    }
+}
 
-                // determine lanes where iteration count is below maximum
-                __m128i vi_iter_lt_max = _mm_cmplt_epi32(vi_iterations, vi_max_iters);
-                __m128 v_iter_lt_max = _mm_castsi128_ps(vi_iter_lt_max);
+/** @brief Compute a span of one row of the image with a SIMD kernel.
+ *
+ * Pixels are handed to IterateSIMD() in groups of Unroll vectors, and each group keeps iterating until its slowest
+ * lane escapes.
+ *
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @tparam Unroll The number of independent vectors to interleave.
+ * @tparam MaxIterations The iteration limit baked into this instantiation, or k_dynamic_iterations.
+ * @param[out] mandelbrot The iteration buffer to write the row into.
+ * @param[in] y The row to compute.
+ * @param[in] x_begin The first column of the span.
+ * @param[in] x_end One past the last column of the span.
+ * @param[in] viewport The mapping from pixels to the complex plane.
+ * @param[in] max_iterations The iteration limit of the render.
+ */
+template <typename Simd, size_t Unroll, size_t MaxIterations>
+auto MandelbrotRowSIMD(Tensor<float, 2>& mandelbrot, size_t y, size_t x_begin, size_t x_end, Viewport<typename Simd::Scalar> const& viewport, size_t max_iterations) -> void
+{
+    using Scalar = typename Simd::Scalar;
+    using Vector = typename Simd::Vector;
+    using Mask = typename Simd::Mask;
+    using Counter = typename Simd::Counter;
 
-                // combine masks to find lanes that are still active
-                __m128 v_active = _mm_and_ps(v_within_bailout, v_iter_lt_max);
+    static constexpr size_t k_width = Simd::k_width;
+    static constexpr size_t k_group_width = k_width * Unroll;
 
-                // create bitmask from active lanes; if no lane is active, exit loop
-                int active_mask = _mm_movemask_ps(v_active);
-                if (!active_mask)
-                {
-                    break;
-                }
+    size_t const limit = IterationLimit<MaxIterations>(max_iterations);
 
-                // increment iteration counts for lanes within bailout
-                __m128i vi_within_bailout_int = _mm_castps_si128(v_within_bailout);
-                __m128i vi_one = _mm_set1_epi32(1);
-                __m128i vi_increment = _mm_and_si128(vi_within_bailout_int, vi_one);
-                vi_iterations = _mm_add_epi32(vi_iterations, vi_increment);
+    // constants shared by every pixel in the row
+    Vector v_real_start = Simd::Set1(viewport.real_start);
+    Vector v_real_step = Simd::Set1(viewport.real_step);
+    Vector v_lane_columns = Simd::Mul(Simd::Iota(), Simd::Set1(static_cast<Scalar>(viewport.sample_stride)));
 
-                // compute new z values using Mandelbrot formula: z = z^2 + c
-                __m128 v_new_z_real = _mm_add_ps(_mm_sub_ps(v_z_real_sq, v_z_imag_sq), v_c_real);
-                __m128 v_new_z_imag = _mm_add_ps(_mm_mul_ps(v_two, _mm_mul_ps(v_z_real, v_z_imag)), v_c_imag);
+    // compute imaginary component for current row
+    Scalar imag = viewport.imag_start + viewport.Row(y) * viewport.imag_step;
+    Vector v_c_imag_row = Simd::Set1(imag);
 
-                // update z values only for lanes that are still within bailout
-                v_z_real = _mm_or_ps(_mm_and_ps(v_within_bailout, v_new_z_real), _mm_andnot_ps(v_within_bailout, v_z_real));
-                v_z_imag = _mm_or_ps(_mm_and_ps(v_within_bailout, v_new_z_imag), _mm_andnot_ps(v_within_bailout, v_z_imag));
+    // process pixels in groups of Unroll vectors; lanes past the end of the span start out inactive so no scalar tail is needed
+    for (size_t x_start = x_begin; x_start < x_end; x_start += k_group_width)
+    {
+        Vector v_c_real[Unroll];
+        Vector v_c_imag[Unroll];
+        Mask m_valid[Unroll];
+
+        for (size_t u = 0; u < Unroll; ++u)
+        {
+            size_t x_vector = x_start + u * k_width;
+
+            // real component: c_real = x * step + start, with x the column of the whole image each lane maps to
+            Vector v_indices = Simd::Add(Simd::Set1(viewport.Column(x_vector)), v_lane_columns);
+            v_c_real[u] = Simd::MulAdd(v_indices, v_real_step, v_real_start);
+            v_c_imag[u] = v_c_imag_row;
+
+            // lanes past the end of the span are never iterated
+            m_valid[u] = Simd::FirstLanes(x_vector < x_end ? x_end - x_vector : 0);
+        }
+
+        Vector v_z_real[Unroll];
+        Vector v_z_imag[Unroll];
+        Counter vi_iterations[Unroll];
+        IterateSIMD<Simd, Unroll, MaxIterations>(v_c_real, v_c_imag, m_valid, max_iterations, vi_iterations, v_z_real, v_z_imag);
+
+        // smooth the iteration counts in registers and store them straight into the row
+        for (size_t u = 0; u < Unroll; ++u)
+        {
+            size_t x_vector = x_start + u * k_width;
+            if (x_vector >= x_end)
+            {
+                break;
+            }
+
+            Vector v_smooth = SmoothIterationSIMD<Simd>(vi_iterations[u], v_z_real[u], v_z_imag[u], limit);
+
+            if (x_vector + k_width <= x_end)
+            {
+                Simd::Store(&mandelbrot({y, x_vector}), v_smooth);
+            }
+            else // the vector runs past the end of the span
+            {
+                float smooth[k_width];
+                Simd::Store(smooth, v_smooth);
+                std::copy(smooth, smooth + (x_end - x_vector), &mandelbrot({y, x_vector}));
             }
+        }
+    }
+}
 
-            // store computed iteration counts and z values from SIMD registers
-            int iter_counts[4];
-            _mm_storeu_si128(reinterpret_cast<__m128i*>(iter_counts), vi_iterations);
+/** @brief Compute a span of one row of the image with a SIMD kernel that refills lanes as soon as they finish.
+ *
+ * Instead of iterating a fixed group of pixels until the slowest lane escapes, a lane whose pixel escapes or reaches
+ * the maximum iteration count is written out and immediately reloaded with the next pending pixel of the span. The loop only
+ * exits once every pixel in the span has been handed to a lane and finished, so lanes do not idle in regions where
+ * neighboring pixels escape at very different iteration counts. As in MandelbrotRowSIMD(), Unroll independent vectors
+ * of lanes are stepped in the same loop, and pixels map to the complex plane through the same vector expression, so
+ * both kernels produce identical rows.
+ *
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @tparam Unroll The number of independent vectors to interleave.
+ * @tparam MaxIterations The iteration limit baked into this instantiation, or k_dynamic_iterations.
+ * @param[out] mandelbrot The iteration buffer to write the row into.
+ * @param[in] y The row to compute.
+ * @param[in] x_begin The first column of the span.
+ * @param[in] x_end One past the last column of the span.
+ * @param[in] viewport The mapping from pixels to the complex plane.
+ * @param[in] max_iterations The iteration limit of the render.
+ */
+template <typename Simd, size_t Unroll, size_t MaxIterations>
+auto MandelbrotRowRefillSIMD(Tensor<float, 2>& mandelbrot, size_t y, size_t x_begin, size_t x_end, Viewport<typename Simd::Scalar> const& viewport, size_t max_iterations) -> void
+{
+    using Scalar = typename Simd::Scalar;
+    using Vector = typename Simd::Vector;
+    using Mask = typename Simd::Mask;
+    using Counter = typename Simd::Counter;
+
+    static constexpr size_t k_width = Simd::k_width;
+    static constexpr size_t k_lanes = k_width * Unroll;
+    static_assert(k_lanes <= 64, "every lane needs a bit in the occupancy mask");
+
+    static constexpr uint64_t k_vector_lanes = (uint64_t(1) << k_width) - 1;
+
+    size_t const limit = IterationLimit<MaxIterations>(max_iterations);
+
+    // constants shared by every pixel in the row
+    Vector v_real_start = Simd::Set1(viewport.real_start);
+    Vector v_real_step = Simd::Set1(viewport.real_step);
+    Vector v_lane_columns = Simd::Mul(Simd::Iota(), Simd::Set1(static_cast<Scalar>(viewport.sample_stride)));
+    Vector v_bailout_sq = Simd::Set1(k_bailout_radius_squared);
+
+    Scalar imag = viewport.imag_start + viewport.Row(y) * viewport.imag_step;
+    Vector v_c_imag = Simd::Set1(imag);
+
+    // per-lane state, spilled to memory whenever lanes are retired and reloaded
+    Scalar c_real[k_lanes];
+    Scalar z_real[k_lanes];
+    Scalar z_imag[k_lanes];
+    Scalar saved_real[k_lanes];
+    Scalar saved_imag[k_lanes];
+    int32_t iterations[k_lanes];
+    int32_t next_save[k_lanes];
+    float smooth[k_width];
+    size_t pixel[k_lanes];
+
+    // bit per lane that currently holds a pixel
+    uint64_t occupied = 0;
+    size_t next_x = x_begin;
+
+    // real components of the k_width pixels from block_begin on, computed a vector at a time exactly as
+    // MandelbrotRowSIMD() does, and a bit per pixel inside the main cardioid or period-2 bulb
+    Scalar block_real[k_width];
+    uint32_t block_inside = 0;
+    size_t block_begin = x_end;
+
+    auto pixel_real = [&](size_t x, bool& inside) -> Scalar
+    {
+        if (x < block_begin || x >= block_begin + k_width)
+        {
+            block_begin = x_begin + (x - x_begin) / k_width * k_width;
 
-            float z_real[4];
-            float z_imag[4];
-            _mm_storeu_ps(z_real, v_z_real);
-            _mm_storeu_ps(z_imag, v_z_imag);
+            Vector v_indices = Simd::Add(Simd::Set1(viewport.Column(block_begin)), v_lane_columns);
+            Vector v_real = Simd::MulAdd(v_indices, v_real_step, v_real_start);
+            Simd::Store(block_real, v_real);
+            block_inside = ~Simd::Bits(OutsideCardioidAndBulb<Simd>(v_real, v_c_imag));
+        }
+
+        inside = (block_inside >> (x - block_begin)) & 1;
+        return block_real[x - block_begin];
+    };
 
-            // assign colors to pixels based on iteration counts
-            for (size_t x = x_start; x < x_start + 4; ++x)
+    // load the next pending pixel into a lane; empty lanes are parked at the maximum iteration count so they never
+    // become active again
+    auto refill = [&](size_t lane)
+    {
+        // pixels inside the main cardioid or period-2 bulb are written out without ever occupying a lane
+        Scalar real = 0;
+        for (; next_x < x_end; ++next_x)
+        {
+            bool inside = false;
+            real = pixel_real(next_x, inside);
+            if (!inside)
             {
-                size_t iteration = iter_counts[x - x_start];
-                std::complex<float> z(z_real[x - x_start], z_imag[x - x_start]);
+                break;
+            }
 
-                if (iteration < k_max_iterations) // points that escape are colored based on the number of iterations it took to escape
-                {
-                    // apply smoothing to reduce banding
-                    float nu = std::log(std::log(std::abs(z))) / std::log(2.0f);
-                    float normalized = (iteration + 1 - nu) / k_max_iterations;
+            mandelbrot({y, next_x}) = static_cast<float>(limit);
+        }
 
-                    // map normalized value to colormap index (range 0 - 255)
-                    size_t index = std::clamp(static_cast<size_t>(normalized * 255.0f), size_t(0), size_t(255));
+        if (next_x < x_end)
+        {
+            pixel[lane] = next_x;
+            c_real[lane] = real;
+            z_real[lane] = 0;
+            z_imag[lane] = 0;
+            saved_real[lane] = 0;
+            saved_imag[lane] = 0;
+            iterations[lane] = 0;
+            next_save[lane] = 1;
+            occupied |= (uint64_t(1) << lane);
+            ++next_x;
+        }
+        else
+        {
+            z_real[lane] = 0;
+            z_imag[lane] = 0;
+            saved_real[lane] = 0;
+            saved_imag[lane] = 0;
+            iterations[lane] = static_cast<int32_t>(limit);
+            next_save[lane] = 1;
+            occupied &= ~(uint64_t(1) << lane);
+        }
+    };
+
+    for (size_t lane = 0; lane < k_lanes; ++lane)
+    {
+        refill(lane);
+    }
 
-                    // retrieve rgb color from colormap palette
-                    auto [red, green, blue] = GetColormapPalette(colormap)[index];
+    Vector v_c_real[Unroll];
+    Vector v_z_real[Unroll];
+    Vector v_z_imag[Unroll];
+    Vector v_saved_real[Unroll];
+    Vector v_saved_imag[Unroll];
+    Counter vi_iterations[Unroll];
+    Counter vi_next_save[Unroll];
 
-                    mandelbrot({y, x, 0}) = red;
-                    mandelbrot({y, x, 1}) = green;
-                    mandelbrot({y, x, 2}) = blue;
+    auto load = [&](size_t u)
+    {
+        size_t const first = u * k_width;
+        v_c_real[u] = Simd::Load(c_real + first);
+        v_z_real[u] = Simd::Load(z_real + first);
+        v_z_imag[u] = Simd::Load(z_imag + first);
+        v_saved_real[u] = Simd::Load(saved_real + first);
+        v_saved_imag[u] = Simd::Load(saved_imag + first);
+        vi_iterations[u] = Simd::Load(iterations + first);
+        vi_next_save[u] = Simd::Load(next_save + first);
+    };
+
+    for (size_t u = 0; u < Unroll; ++u)
+    {
+        load(u);
+    }
+
+    Vector v_epsilon_sq = Simd::Set1(k_periodicity_epsilon_squared<Scalar>);
+    Counter vi_max_iterations = Simd::CounterSet1(static_cast<int32_t>(limit));
+
+    Vector v_z_real_sq[Unroll];
+    Vector v_z_imag_sq[Unroll];
+    Mask m_active[Unroll];
+
+    while (occupied)
+    {
+        // lanes keep iterating while within bailout and below the maximum iteration count; lanes that hold a pixel but
+        // are no longer active have finished
+        uint64_t finished = 0;
+        for (size_t u = 0; u < Unroll; ++u)
+        {
+            v_z_real_sq[u] = Simd::Mul(v_z_real[u], v_z_real[u]);
+            v_z_imag_sq[u] = Simd::Mul(v_z_imag[u], v_z_imag[u]);
+            Vector v_z_magnitude = Simd::Add(v_z_real_sq[u], v_z_imag_sq[u]);
+
+            m_active[u] = Simd::And(Simd::LessThan(v_z_magnitude, v_bailout_sq), Simd::LessThan(vi_iterations[u], static_cast<int32_t>(limit)));
+            finished |= (~uint64_t(Simd::Bits(m_active[u])) & k_vector_lanes) << (u * k_width);
+        }
+        finished &= occupied;
+
+        // write the finished lanes out and load the next pixels into them, one vector at a time
+        if (finished)
+        {
+            for (size_t u = 0; u < Unroll; ++u)
+            {
+                uint64_t const vector_finished = (finished >> (u * k_width)) & k_vector_lanes;
+                if (!vector_finished)
+                {
+                    continue;
                 }
-                else // color non-escaped points as black
+
+                size_t const first = u * k_width;
+                Simd::Store(c_real + first, v_c_real[u]);
+                Simd::Store(z_real + first, v_z_real[u]);
+                Simd::Store(z_imag + first, v_z_imag[u]);
+                Simd::Store(saved_real + first, v_saved_real[u]);
+                Simd::Store(saved_imag + first, v_saved_imag[u]);
+                Simd::Store(iterations + first, vi_iterations[u]);
+                Simd::Store(next_save + first, vi_next_save[u]);
+                Simd::Store(smooth, SmoothIterationSIMD<Simd>(vi_iterations[u], v_z_real[u], v_z_imag[u], limit));
+
+                for (size_t lane = 0; lane < k_width; ++lane)
                 {
-                    mandelbrot({y, x, 0}) = 0;
-                    mandelbrot({y, x, 1}) = 0;
-                    mandelbrot({y, x, 2}) = 0;
+                    if (vector_finished & (uint64_t(1) << lane))
+                    {
+                        mandelbrot({y, pixel[first + lane]}) = smooth[lane];
+                        refill(first + lane);
+                    }
                 }
+
+                load(u);
             }
+
+            // re-evaluate the refilled lanes before stepping
+            continue;
         }
 
-        // process any trailing pixels with scalar code
-        for (size_t x = (width - width % 4); x < width; ++x)
+        // the compiler fully unrolls this loop, leaving Unroll independent dependency chains per step
+        for (size_t u = 0; u < Unroll; ++u)
         {
-            // compute real component for current pixel
-            float ratio = static_cast<float>(x) / (width - 1);
-            float real = k_real_start + ratio * (k_real_stop - k_real_start);
-            std::complex<float> c(real, imag);
-            std::complex<float> z(0, 0);
-            size_t iteration = 0;
-
-            // iterate Mandelbrot formula
-            while (std::abs(z) < k_bailout_radius && iteration < k_max_iterations)
-            {
-                z = z * z + c;
-                ++iteration;
-            }
+            // increment iteration counts and step z = z^2 + c for active lanes
+            vi_iterations[u] = Simd::Increment(vi_iterations[u], m_active[u]);
+
+            Vector v_new_z_real = Simd::Add(Simd::Sub(v_z_real_sq[u], v_z_imag_sq[u]), v_c_real[u]);
+            Vector v_new_z_imag = Simd::MulAdd(Simd::Add(v_z_real[u], v_z_real[u]), v_z_imag[u], v_c_imag);
+
+            v_z_real[u] = Simd::Select(m_active[u], v_new_z_real, v_z_real[u]);
+            v_z_imag[u] = Simd::Select(m_active[u], v_new_z_imag, v_z_imag[u]);
+
+            // lanes whose orbit revisited the saved value are cyclic; park them at the maximum iteration count so they
+            // are retired on the next step
+            Vector v_delta_real = Simd::Sub(v_z_real[u], v_saved_real[u]);
+            Vector v_delta_imag = Simd::Sub(v_z_imag[u], v_saved_imag[u]);
+            Vector v_delta_sq = Simd::MulAdd(v_delta_real, v_delta_real, Simd::Mul(v_delta_imag, v_delta_imag));
+            Mask m_periodic = Simd::And(m_active[u], Simd::LessThan(v_delta_sq, v_epsilon_sq));
+            vi_iterations[u] = Simd::Select(m_periodic, vi_max_iterations, vi_iterations[u]);
+
+            // lanes run the brent schedule independently, so each saves z once its own count reaches its next power of two
+            Mask m_save = Simd::And(m_active[u], Simd::Equal(vi_iterations[u], vi_next_save[u]));
+            v_saved_real[u] = Simd::Select(m_save, v_z_real[u], v_saved_real[u]);
+            v_saved_imag[u] = Simd::Select(m_save, v_z_imag[u], v_saved_imag[u]);
+            vi_next_save[u] = Simd::Select(m_save, Simd::Add(vi_next_save[u], vi_next_save[u]), vi_next_save[u]);
+        }
+    }
+}
 
-            if (iteration < k_max_iterations) // point escaped; compute color based on iteration count
-            {
-                float nu = std::log(std::log(std::abs(z))) / std::log(2.0f);
-                float normalized = (iteration + 1 - nu) / k_max_iterations;
-                size_t index = std::clamp(static_cast<size_t>(normalized * 255.0f), size_t(0), size_t(255));
-                auto [red, green, blue] = GetColormapPalette(colormap)[index];
-
-                mandelbrot({y, x, 0}) = red;
-                mandelbrot({y, x, 1}) = green;
-                mandelbrot({y, x, 2}) = blue;
-            }
-            else // point did not escape; color black
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set with a SIMD kernel.
+ * @tparam Simd The instruction set wrapper to use (see Simd.hpp).
+ * @tparam Unroll The number of independent vectors to interleave (1, 2, and 4 are sensible choices).
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] lane_mode How pixels are assigned to vector lanes.
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+template <typename Simd, size_t Unroll>
+auto MandelbrotSIMD(ThreadPool& pool, RenderParams const& params, LaneMode lane_mode, size_t tile_size) -> Tensor<float, 2>
+{
+    static_assert(Unroll >= 1, "at least one vector must be iterated");
+
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
+    auto viewport = GetViewport<typename Simd::Scalar>(params);
+
+    WithIterationLimit(params.max_iterations, [&](auto max_iterations_constant)
+    {
+        static constexpr size_t MaxIterations = decltype(max_iterations_constant)::value;
+
+        // apply the following operation to every row of every tile in the image
+        DispatchTiles(pool, params.height, params.width, tile_size, [&](Tile const& tile)
+        {
+            Simd::Run([&]()
             {
-                mandelbrot({y, x, 0}) = 0;
-                mandelbrot({y, x, 1}) = 0;
-                mandelbrot({y, x, 2}) = 0;
-            }
-        }
+                for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+                {
+                    if (lane_mode == LaneMode::Refill)
+                    {
+                        MandelbrotRowRefillSIMD<Simd, Unroll, MaxIterations>(mandelbrot, y, tile.x_begin, tile.x_end, viewport, params.max_iterations);
+                    }
+                    else
+                    {
+                        MandelbrotRowSIMD<Simd, Unroll, MaxIterations>(mandelbrot, y, tile.x_begin, tile.x_end, viewport, params.max_iterations);
+                    }
+                }
+            });
+        });
     });
 
     return mandelbrot;
+}
+
+template <size_t Unroll = k_default_unroll>
+auto MandelbrotSSE([[maybe_unused]] ThreadPool& pool, [[maybe_unused]] RenderParams const& params, [[maybe_unused]] LaneMode lane_mode = LaneMode::Grouped, [[maybe_unused]] size_t tile_size = k_default_tile_size) -> Tensor<float, 2>
+{
+#if __SUPPORTS_SSE__
+    return WithPrecision(params, [&](auto scalar)
+    {
+        return MandelbrotSIMD<SimdSSE<decltype(scalar)>, Unroll>(pool, params, lane_mode, tile_size);
+    });
 #else
     throw std::runtime_error("this binary was not compiled with SSE support");
 #endif
 }
 
-auto MandelbrotNEON(size_t height, size_t width, Colormap colormap) -> Tensor<uint8_t, 3>
+template <size_t Unroll = k_default_unroll>
+auto MandelbrotAVX2([[maybe_unused]] ThreadPool& pool, [[maybe_unused]] RenderParams const& params, [[maybe_unused]] LaneMode lane_mode = LaneMode::Grouped, [[maybe_unused]] size_t tile_size = k_default_tile_size) -> Tensor<float, 2>
+{
+#if __SUPPORTS_AVX2__
+    return WithPrecision(params, [&](auto scalar)
+    {
+        return MandelbrotSIMD<SimdAVX2<decltype(scalar)>, Unroll>(pool, params, lane_mode, tile_size);
+    });
+#else
+    throw std::runtime_error("this binary was not compiled with AVX2 support");
+#endif
+}
+
+template <size_t Unroll = k_default_unroll>
+auto MandelbrotAVX512([[maybe_unused]] ThreadPool& pool, [[maybe_unused]] RenderParams const& params, [[maybe_unused]] LaneMode lane_mode = LaneMode::Grouped, [[maybe_unused]] size_t tile_size = k_default_tile_size) -> Tensor<float, 2>
+{
+#if __SUPPORTS_AVX512__
+    return WithPrecision(params, [&](auto scalar)
+    {
+        return MandelbrotSIMD<SimdAVX512<decltype(scalar)>, Unroll>(pool, params, lane_mode, tile_size);
+    });
+#else
+    throw std::runtime_error("this binary was not compiled with AVX-512 support");
+#endif
+}
+
+auto MandelbrotNEON([[maybe_unused]] ThreadPool& pool, [[maybe_unused]] RenderParams const& params) -> Tensor<float, 2>
 {
 #if __SUPPORTS_NEON__
     std::cout << "WARNING: NEON not yet implemented, falling back to generic version" << std::endl;
-    return MandelbrotGeneric(height, width, colormap);
+    return MandelbrotGeneric(pool, params);
 #else
     throw std::runtime_error("this binary was not compiled with NEON support");
 #endif
 }
 
-auto Mandelbrot(size_t height, size_t width, Colormap colormap) -> Tensor<uint8_t, 3>
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set with the widest supported kernel.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render.
+ * @param[in] lane_mode How pixels are assigned to vector lanes.
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] verbose Whether to print which kernel was picked.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+auto Mandelbrot(ThreadPool& pool, RenderParams const& params, LaneMode lane_mode = LaneMode::Grouped, size_t tile_size = k_default_tile_size, bool verbose = true) -> Tensor<float, 2>
 {
-    if (SupportsSSE())
+    auto announce = [&](char const* instruction_set)
+    {
+        if (verbose)
+        {
+            std::cout << "Running Mandelbrot with " << instruction_set << " instruction set." << std::endl;
+        }
+    };
+
+    if (__SUPPORTS_AVX512__ && SupportsAVX512())
+    {
+        announce("AVX-512");
+        return MandelbrotAVX512(pool, params, lane_mode, tile_size);
+    }
+    else if (__SUPPORTS_AVX2__ && SupportsAVX2())
+    {
+        announce("AVX2");
+        return MandelbrotAVX2(pool, params, lane_mode, tile_size);
+    }
+    else if (SupportsSSE())
     {
-        std::cout << "Running Mandelbrot with SSE instruction set." << std::endl;
-        return MandelbrotSSE(height, width, colormap);
+        announce("SSE");
+        return MandelbrotSSE(pool, params, lane_mode, tile_size);
     }
     else if (SupportsNEON())
     {
-        std::cout << "Running Mandelbrot with NEON instruction set." << std::endl;
-        return MandelbrotNEON(height, width, colormap);
+        announce("NEON");
+        return MandelbrotNEON(pool, params);
     }
     else
     {
-        std::cout << "Running Mandelbrot with generic instruction set." << std::endl;
-        return MandelbrotGeneric(height, width, colormap);
+        announce("generic");
+        return MandelbrotGeneric(pool, params, tile_size);
     }
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <PNG.hpp>
+#include <PPM.hpp>
+#include <Tensor.hpp>
+#include <ThreadPool.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+enum class ImageFormat
+{
+    Png, // deflate compressed, the default
+    Ppm, // binary ppm (P6): a short header followed by the raw pixels
+    Raw, // interleaved rgb bytes with no header
+};
+
+/** @brief Pick the output format from the extension of the output path.
+ * @param[in] path The output path; .png, .ppm, and .raw (or .rgb) are recognized, case sensitively.
+ * @returns The format to write.
+ */
+auto GetImageFormatByPath(std::string const& path) -> ImageFormat
+{
+    auto extension = std::filesystem::path(path).extension().string();
+
+    if (extension == ".png")
+    {
+        return ImageFormat::Png;
+    }
+    else if (extension == ".ppm")
+    {
+        return ImageFormat::Ppm;
+    }
+    else if (extension == ".raw" || extension == ".rgb")
+    {
+        return ImageFormat::Raw;
+    }
+    else
+    {
+        std::cerr << "unrecognized output extension, defaulting to png" << std::endl;
+        return ImageFormat::Png;
+    }
+}
+
+/** @brief Get the bytes that precede the pixels of an uncompressed image format.
+ * @param[in] format The format, which must not be ImageFormat::Png.
+ * @param[in] width The width of the image in pixels.
+ * @param[in] height The height of the image in pixels.
+ * @returns The header (empty for raw output).
+ */
+auto GetImageHeader(ImageFormat format, size_t width, size_t height) -> std::string
+{
+    return format == ImageFormat::Ppm ? PpmHeader(width, height) : std::string();
+}
+
+/** @brief Write an image in the given format.
+ * @param[in] pool The worker threads to encode on (png only).
+ * @param[in] format The format to write.
+ * @param[in] filename The path to write to.
+ * @param[in] rgb A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ * @param[in] compression The deflate compression level (png only).
+ */
+auto WriteImage(ThreadPool& pool, ImageFormat format, std::string const& filename, Tensor<uint8_t, 3> const& rgb, int compression) -> void
+{
+    switch (format)
+    {
+    case ImageFormat::Ppm:
+        EncodePpm(filename, rgb);
+        break;
+    case ImageFormat::Raw:
+        EncodeRaw(filename, rgb);
+        break;
+    case ImageFormat::Png:
+    default:
+        EncodePng(pool, filename, rgb, compression);
+        break;
+    }
+}
+
+/** @brief Write an image in the given format, encoding it on the calling thread alone.
+ *
+ * For writing several images at once from threads of their own, while the thread pool is busy with something else.
+ *
+ * @param[in] format The format to write.
+ * @param[in] filename The path to write to.
+ * @param[in] rgb A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ * @param[in] compression The deflate compression level (png only).
+ */
+auto WriteImage(ImageFormat format, std::string const& filename, Tensor<uint8_t, 3> const& rgb, int compression) -> void
+{
+    auto [height, width, channels] = rgb.Shape();
+
+    switch (format)
+    {
+    case ImageFormat::Ppm:
+        EncodePpm(filename, rgb);
+        break;
+    case ImageFormat::Raw:
+        EncodeRaw(filename, rgb);
+        break;
+    case ImageFormat::Png:
+    default:
+        PngWriter(filename, width, height, compression).WriteRows(rgb);
+        break;
+    }
+}
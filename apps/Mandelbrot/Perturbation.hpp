@@ -0,0 +1,396 @@
+#pragma once
+
+#include <FixedPoint.hpp>
+#include <Tensor.hpp>
+
+#include "Mandelbrot.hpp"
+#include "RenderParams.hpp"
+#include "Scheduler.hpp"
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*
+
+    perturbation rendering for views too deep for double precision
+
+    a single reference orbit Z is computed at the center of the view with as many bits as the zoom needs, and every
+    pixel c = C + dc only iterates its (tiny) difference from that orbit in double precision:
+
+        z = Z + dz,  dz' = 2 * Z * dz + dz^2 + dc
+
+    the delta loses its meaning once the pixel's orbit passes closer to zero than the delta itself is small (a glitch),
+    or once the reference orbit escapes before the pixel does; either way the pixel is rebased: its full value becomes
+    the new delta against the start of the reference orbit (Z = 0), and iteration continues from there
+
+    for the first iterations of a deep zoom, the deltas of every pixel are still a smooth function of dc, so they are
+    approximated by a truncated power series dz = a_1 * dc + a_2 * dc^2 + ... whose coefficients follow from the
+    reference orbit alone; every pixel then starts from the series at iteration N instead of from zero
+
+*/
+
+// bits kept beyond what is needed to tell neighboring pixels apart
+static constexpr size_t k_reference_guard_bits = 64;
+
+/** @brief Get the number of 32-bit fraction limbs the reference orbit of a render is computed with.
+ * @param[in] params The render to size for.
+ * @returns The number of fraction limbs.
+ */
+auto GetReferenceFractionLimbs(RenderParams const& params) -> size_t
+{
+    double bits = std::max(0.0, -std::log2(GetPixelStep(params))) + k_reference_guard_bits;
+    return static_cast<size_t>(std::ceil(bits / 32.0));
+}
+
+/** @brief Get one coordinate of the center of a render at full precision.
+ * @param[in] digits The coordinate as typed, or empty if only the double is known.
+ * @param[in] value The coordinate as a double.
+ * @param[in] fraction_limbs The number of 32-bit fraction limbs to keep.
+ * @returns The coordinate.
+ */
+auto GetCenterCoordinate(std::string const& digits, double value, size_t fraction_limbs) -> FixedPoint
+{
+    return digits.empty() ? FixedPoint::FromDouble(value, fraction_limbs) : FixedPoint::FromString(digits, fraction_limbs);
+}
+
+/** @brief Compute the orbit of the center of a render at full precision.
+ * @param[in] params The render to compute the reference for.
+ * @returns Z for iterations 0 (always zero) up to the iteration the center escaped at, or the limit, rounded to double.
+ */
+auto ComputeReferenceOrbit(RenderParams const& params) -> std::vector<std::complex<double>>
+{
+    size_t fraction_limbs = GetReferenceFractionLimbs(params);
+    FixedPoint c_real = GetCenterCoordinate(params.center_real_digits, params.center_real, fraction_limbs);
+    FixedPoint c_imag = GetCenterCoordinate(params.center_imag_digits, params.center_imag, fraction_limbs);
+
+    FixedPoint z_real(fraction_limbs);
+    FixedPoint z_imag(fraction_limbs);
+
+    std::vector<std::complex<double>> orbit;
+    orbit.reserve(params.max_iterations + 1);
+    orbit.emplace_back(0.0, 0.0);
+
+    for (size_t iteration = 0; iteration < params.max_iterations; ++iteration)
+    {
+        // z = z^2 + c with three multiplies
+        FixedPoint real_sq = z_real * z_real;
+        FixedPoint imag_sq = z_imag * z_imag;
+        FixedPoint cross = z_real * z_imag;
+        z_real = real_sq - imag_sq + c_real;
+        z_imag = cross + cross + c_imag;
+
+        std::complex<double> z(z_real.ToDouble(), z_imag.ToDouble());
+        orbit.push_back(z);
+
+        // stop before squaring a value too large for the integer part
+        if (std::norm(z) >= k_bailout_radius_squared)
+        {
+            break;
+        }
+    }
+
+    return orbit;
+}
+
+// squared magnitudes below this have lost bits to underflow (deltas below about 1e-150); the glitch test compares the
+// magnitudes themselves there
+static constexpr double k_min_exact_magnitude_sq = 1e-290;
+
+/** @brief Check whether a pixel's orbit has passed closer to zero than its delta from the reference is large, which
+ * leaves the delta without the precision to continue from.
+ * @param[in] z_real The real part of the pixel's z.
+ * @param[in] z_imag The imaginary part of the pixel's z.
+ * @param[in] dz_real The real part of the pixel's delta.
+ * @param[in] dz_imag The imaginary part of the pixel's delta.
+ * @returns Whether |z| < |dz|.
+ */
+auto IsGlitched(double z_real, double z_imag, double dz_real, double dz_imag) -> bool
+{
+    double dz_magnitude_sq = dz_real * dz_real + dz_imag * dz_imag;
+    if (dz_magnitude_sq >= k_min_exact_magnitude_sq)
+    {
+        // a z too small to square is smaller than this delta either way
+        return z_real * z_real + z_imag * z_imag < dz_magnitude_sq;
+    }
+    return std::hypot(z_real, z_imag) < std::hypot(dz_real, dz_imag);
+}
+
+// number of terms the series approximation is truncated to
+static constexpr size_t k_series_terms = 6;
+
+// largest error the series may make in the delta of a pixel, relative to the delta itself; the iterations after the
+// series amplify an error in the delta just as they amplify the delta, so only a relative bound keeps it invisible
+static constexpr double k_series_tolerance = 1e-12;
+
+// the deltas of every pixel of a view after some number of skipped iterations, as a power series in dc
+struct SeriesApproximation
+{
+    size_t skipped;                                 // iterations every pixel skips
+    double radius;                                  // |dc| of the farthest pixel; coefficients are scaled by radius^k
+    std::vector<std::complex<double>> coefficients; // a_k * radius^k for k = 1 to k_series_terms
+};
+
+/** @brief Evaluate a series approximation for one pixel.
+ * @param[in] series The series to evaluate.
+ * @param[in] delta_c The offset of the pixel from the reference point.
+ * @returns The delta of the pixel after series.skipped iterations.
+ */
+auto EvaluateSeries(SeriesApproximation const& series, std::complex<double> delta_c) -> std::complex<double>
+{
+    if (series.skipped == 0)
+    {
+        return {0.0, 0.0};
+    }
+
+    // horner's rule in the scaled variable u = dc / radius, which keeps every term in range
+    std::complex<double> u = delta_c / series.radius;
+    std::complex<double> sum(0.0, 0.0);
+    for (size_t k = series.coefficients.size(); k-- > 0;)
+    {
+        sum = (sum + series.coefficients[k]) * u;
+    }
+
+    return sum;
+}
+
+/** @brief Find how many iterations every pixel of a view can skip, and the series that skips them.
+ *
+ * The coefficients are advanced one iteration at a time with a'_k = 2 * Z * a_k + sum(a_i * a_j, i + j = k) (plus 1
+ * for a_1), alongside exact perturbed orbits of probe pixels at the corners, edge midpoints, center, and quarter points
+ * of the view. Iteration stops as soon as the last term of the series grows past k_series_tolerance of the first, the
+ * series misses any probe's delta by more than k_series_tolerance of that delta, or a probe glitches.
+ *
+ * @param[in] reference The reference orbit (see ComputeReferenceOrbit()).
+ * @param[in] first The dc of the first pixel of the render (its top left corner).
+ * @param[in] last The dc of the last pixel of the render (its bottom right corner).
+ * @param[in] step The pixel spacing.
+ * @returns The series at the last iteration that passed every check.
+ */
+auto ComputeSeriesApproximation(std::vector<std::complex<double>> const& reference, std::complex<double> first, std::complex<double> last, double step) -> SeriesApproximation
+{
+    std::complex<double> const middle = (first + last) / 2.0;
+    std::complex<double> const low = (first + middle) / 2.0;
+    std::complex<double> const high = (middle + last) / 2.0;
+    std::complex<double> const probes[] = {
+        {first.real(), first.imag()},  {middle.real(), first.imag()},  {last.real(), first.imag()},
+        {first.real(), middle.imag()}, {middle.real(), middle.imag()}, {last.real(), middle.imag()},
+        {first.real(), last.imag()},   {middle.real(), last.imag()},   {last.real(), last.imag()},
+        {low.real(), low.imag()},      {high.real(), low.imag()},
+        {low.real(), high.imag()},     {high.real(), high.imag()},
+    };
+
+    // the corners are the pixels farthest from the reference (a band of a larger image need not be centered on it)
+    double radius = step;
+    for (std::complex<double> const& probe : probes)
+    {
+        radius = std::max(radius, std::abs(probe));
+    }
+
+    SeriesApproximation series{0, radius, std::vector<std::complex<double>>(k_series_terms)};
+
+    std::complex<double> probe_deltas[std::size(probes)] = {};
+
+    std::vector<std::complex<double>> coefficients(k_series_terms);
+    std::vector<std::complex<double>> next(k_series_terms);
+
+    // the next iteration has to exist in the reference orbit for pixels to continue from it
+    for (size_t iteration = 0; iteration + 2 < reference.size(); ++iteration)
+    {
+        std::complex<double> twice_z = 2.0 * reference[iteration];
+
+        for (size_t k = 0; k < k_series_terms; ++k)
+        {
+            // coefficient k holds the term of degree k + 1
+            std::complex<double> square(0.0, 0.0);
+            for (size_t i = 0; i + 1 <= k; ++i)
+            {
+                square += coefficients[i] * coefficients[k - 1 - i];
+            }
+            next[k] = twice_z * coefficients[k] + square + (k == 0 ? std::complex<double>(series.radius, 0.0) : 0.0);
+        }
+        std::swap(coefficients, next);
+
+        // the scaled terms are the sizes of the terms at the farthest pixel, so the last one bounds the truncation error
+        bool valid = std::abs(coefficients.back()) <= k_series_tolerance * std::abs(coefficients[0]);
+
+        SeriesApproximation candidate{iteration + 1, series.radius, coefficients};
+        for (size_t probe = 0; probe < std::size(probes) && valid; ++probe)
+        {
+            std::complex<double>& delta = probe_deltas[probe];
+            delta = (twice_z + delta) * delta + probes[probe];
+
+            std::complex<double> z = reference[iteration + 1] + delta;
+            valid = !IsGlitched(z.real(), z.imag(), delta.real(), delta.imag()) && std::abs(EvaluateSeries(candidate, probes[probe]) - delta) <= k_series_tolerance * std::abs(delta);
+        }
+
+        if (!valid)
+        {
+            break;
+        }
+
+        series = std::move(candidate);
+    }
+
+    return series;
+}
+
+/** @brief Iterate the Mandelbrot function for a single point as a perturbation of the reference orbit.
+ * @tparam MaxIterations The iteration limit baked into this instantiation, or k_dynamic_iterations.
+ * @param[in] reference The reference orbit (see ComputeReferenceOrbit()).
+ * @param[in] delta_c The offset of the point from the reference point.
+ * @param[in] series The iterations to skip and the series giving the delta of the point after them.
+ * @param[in] max_iterations The iteration limit of the render.
+ * @returns The iteration count and final z of the point.
+ */
+template <size_t MaxIterations = k_dynamic_iterations>
+auto IteratePerturbed(std::vector<std::complex<double>> const& reference, std::complex<double> delta_c, SeriesApproximation const& series, size_t max_iterations) -> Orbit<double>
+{
+    size_t const limit = IterationLimit<MaxIterations>(max_iterations);
+
+    // every pixel starts where the series leaves it
+    std::complex<double> delta_z = EvaluateSeries(series, delta_c);
+
+    double dc_real = delta_c.real();
+    double dc_imag = delta_c.imag();
+    double dz_real = delta_z.real();
+    double dz_imag = delta_z.imag();
+    double z_real = reference[series.skipped].real() + dz_real;
+    double z_imag = reference[series.skipped].imag() + dz_imag;
+
+    // index into the reference orbit, which falls behind the iteration count every time the point is rebased
+    size_t reference_index = series.skipped;
+    size_t iteration = series.skipped;
+
+    while (iteration < limit)
+    {
+        // dz = (2 * Z + dz) * dz + dc
+        double sum_real = 2.0 * reference[reference_index].real() + dz_real;
+        double sum_imag = 2.0 * reference[reference_index].imag() + dz_imag;
+        double new_dz_real = sum_real * dz_real - sum_imag * dz_imag + dc_real;
+        dz_imag = sum_real * dz_imag + sum_imag * dz_real + dc_imag;
+        dz_real = new_dz_real;
+
+        ++reference_index;
+        ++iteration;
+
+        z_real = reference[reference_index].real() + dz_real;
+        z_imag = reference[reference_index].imag() + dz_imag;
+
+        double z_magnitude_sq = z_real * z_real + z_imag * z_imag;
+        if (z_magnitude_sq >= k_bailout_radius_squared)
+        {
+            break;
+        }
+
+        // rebase on a glitch, or when the next step would run off the end of the reference orbit
+        if (IsGlitched(z_real, z_imag, dz_real, dz_imag) || reference_index + 1 == reference.size())
+        {
+            dz_real = z_real;
+            dz_imag = z_imag;
+            reference_index = 0;
+        }
+    }
+
+    return {iteration, {z_real, z_imag}, false};
+}
+
+// the reference orbit of an image and the series approximation every pixel of it starts from
+struct PerturbationReference
+{
+    std::vector<std::complex<double>> orbit;
+    SeriesApproximation series;
+};
+
+/** @brief Compute the reference orbit and series approximation of an image.
+ *
+ * Both only depend on the whole image, never on which part of it the parameters select, so every band, window, and
+ * lattice of one image can share them instead of computing them again.
+ *
+ * @param[in] params The size, view, and iteration limit of the image, or of any part of it.
+ * @returns The reference of the whole image.
+ */
+auto ComputePerturbationReference(RenderParams const& params) -> PerturbationReference
+{
+    auto orbit = ComputeReferenceOrbit(params);
+
+    // the series has to hold for the corners of the whole image, relative to its center
+    double step = GetPixelStep(params);
+    double real_offset = -step * GetCenterColumn(params);
+    double imag_offset = -step * GetCenterRow(params);
+
+    std::complex<double> first_pixel(real_offset, imag_offset);
+    std::complex<double> last_pixel(real_offset + static_cast<double>(GetImageWidth(params) - 1) * step, imag_offset + static_cast<double>(GetImageHeight(params) - 1) * step);
+    auto series = ComputeSeriesApproximation(orbit, first_pixel, last_pixel, step);
+
+    return {std::move(orbit), std::move(series)};
+}
+
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set by perturbation.
+ *
+ * Reaches far deeper zooms than MandelbrotGeneric() at about the same cost per pixel; views shallow enough for double
+ * precision come out the same up to rounding. The zoom is limited by the exponent range of the double deltas
+ * (around 1e300).
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render; the center is read from its digits when given.
+ * @param[in] reference The reference of the image the render is part of (see ComputePerturbationReference()).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] verbose Whether to print how many iterations the series approximation skips.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+auto MandelbrotPerturbation(ThreadPool& pool, RenderParams const& params, PerturbationReference const& reference, size_t tile_size = k_default_tile_size, bool verbose = true) -> Tensor<float, 2>
+{
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
+
+    // the pixel mapping of GetViewport(), relative to the center so no digits are lost
+    double step = GetPixelStep(params);
+    double real_offset = -step * GetCenterColumn(params);
+    double imag_offset = -step * GetCenterRow(params);
+    auto viewport = GetViewport<double>(params); // only for Row() and Column(), which place windows and lattices
+
+    if (verbose)
+    {
+        std::cout << "Series approximation skips " << reference.series.skipped << " iterations." << std::endl;
+    }
+
+    WithIterationLimit(params.max_iterations, [&](auto max_iterations_constant)
+    {
+        static constexpr size_t MaxIterations = decltype(max_iterations_constant)::value;
+
+        DispatchTiles(pool, params.height, params.width, tile_size, [&](Tile const& tile)
+        {
+            for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+            {
+                double delta_imag = imag_offset + viewport.Row(y) * step;
+
+                for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+                {
+                    double delta_real = real_offset + viewport.Column(x) * step;
+
+                    auto orbit = IteratePerturbed<MaxIterations>(reference.orbit, {delta_real, delta_imag}, reference.series, params.max_iterations);
+
+                    mandelbrot({y, x}) = SmoothIteration(orbit.iteration, orbit.z, params.max_iterations);
+                }
+            }
+        });
+    });
+
+    return mandelbrot;
+}
+
+/** @brief Compute the smoothed iteration count of every pixel of the Mandelbrot set by perturbation, computing the
+ * reference of the image first.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] params The size, view, and iteration limit of the render; the center is read from its digits when given.
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[in] verbose Whether to print how many iterations the series approximation skips.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts (see SmoothIteration()).
+ */
+auto MandelbrotPerturbation(ThreadPool& pool, RenderParams const& params, size_t tile_size = k_default_tile_size, bool verbose = true) -> Tensor<float, 2>
+{
+    return MandelbrotPerturbation(pool, params, ComputePerturbationReference(params), tile_size, verbose);
+}
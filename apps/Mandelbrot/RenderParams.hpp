@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+// iteration limit used when none is requested
+static constexpr size_t k_default_max_iterations = 100;
+
+// marks a kernel instantiation that reads its iteration limit at runtime instead of having it baked in
+static constexpr size_t k_dynamic_iterations = 0;
+
+// center of the view when none is requested
+static constexpr double k_default_center_real = -0.75;
+static constexpr double k_default_center_imag = 0.0;
+
+// size of the region of the complex plane that a zoom of 1 fits into the image, which covers the whole set
+static constexpr double k_unzoomed_real_extent = 3.5;
+static constexpr double k_unzoomed_imag_extent = 2.0;
+
+// floating point type the kernels iterate in
+enum class Precision
+{
+    Auto,   // single precision unless the pixel spacing is too fine for it
+    Single, // float
+    Double, // double
+};
+
+auto GetPrecisionByName(std::string const& name) -> Precision
+{
+    if (name == "auto")
+    {
+        return Precision::Auto;
+    }
+    else if (name == "single")
+    {
+        return Precision::Single;
+    }
+    else if (name == "double")
+    {
+        return Precision::Double;
+    }
+    else
+    {
+        std::cerr << "invalid precision requested, defaulting to auto" << std::endl;
+        return Precision::Auto;
+    }
+}
+
+// float is used as long as neighboring pixels are at least this many float ulps apart
+static constexpr double k_min_ulps_per_pixel = 256.0;
+
+// what to render
+struct RenderParams
+{
+    size_t height = 2160;
+    size_t width = 3840;
+    double center_real = k_default_center_real;
+    double center_imag = k_default_center_imag;
+
+    // the center as typed, when it carries more digits than a double holds; only the perturbation engine reads these
+    std::string center_real_digits;
+    std::string center_imag_digits;
+
+    // whether the center lands on pixel (width / 2, height / 2) of the image rather than halfway between the middle two
+    // pixels of an even side; zooms about a pixel keep the pixel grids of successive frames lined up (see Reproject.hpp)
+    bool center_on_pixel = false;
+
+    double zoom = 1.0; // magnification relative to the unzoomed view
+    size_t max_iterations = k_default_max_iterations;
+    Precision precision = Precision::Auto;
+
+    // when rendering one window (a band or a tile) of a larger image: the size of the whole image (0 if the render
+    // spans it in that direction) and the row and column of it the window starts at
+    size_t image_height = 0;
+    size_t image_width = 0;
+    size_t first_row = 0;
+    size_t first_column = 0;
+
+    // when rendering only every sample_stride-th row and column of the image (a coarser lattice of its pixels): the
+    // stride and the row and column of the image the lattice starts at; rows and columns above count lattice points
+    size_t sample_stride = 1;
+    size_t sample_row = 0;
+    size_t sample_column = 0;
+};
+
+// mapping from pixel coordinates to points in the complex plane: real = real_start + Column(x) * real_step, and
+// imag = imag_start + Row(y) * imag_step, where Column() and Row() give the pixel's column and row in the whole image,
+// so every window or lattice of an image maps its pixels exactly like the whole image does
+template <typename T>
+struct Viewport
+{
+    T real_start;
+    T real_step;
+    T imag_start;
+    T imag_step;
+    size_t first_row;
+    size_t first_column;
+    size_t sample_stride;
+    size_t sample_row;
+    size_t sample_column;
+
+    // column of the whole image that column x of the render maps to
+    auto Column(size_t x) const -> T
+    {
+        return static_cast<T>(sample_column + sample_stride * (first_column + x));
+    }
+
+    // row of the whole image that row y of the render maps to
+    auto Row(size_t y) const -> T
+    {
+        return static_cast<T>(sample_row + sample_stride * (first_row + y));
+    }
+};
+
+/** @brief Get the height of the image a render is part of.
+ * @param[in] params The render to measure.
+ * @returns The height of the whole image, which is the height of the render unless it is a window of it.
+ */
+auto GetImageHeight(RenderParams const& params) -> size_t
+{
+    return params.image_height != 0 ? params.image_height : params.height;
+}
+
+/** @brief Get the width of the image a render is part of.
+ * @param[in] params The render to measure.
+ * @returns The width of the whole image, which is the width of the render unless it is a window of it.
+ */
+auto GetImageWidth(RenderParams const& params) -> size_t
+{
+    return params.image_width != 0 ? params.image_width : params.width;
+}
+
+/** @brief Get the column of the image that the center of the view falls on.
+ * @param[in] params The render to measure.
+ * @returns The column, which is halfway between two pixels when the width is even unless the view is centered on a pixel.
+ */
+auto GetCenterColumn(RenderParams const& params) -> double
+{
+    double columns = static_cast<double>(std::max(GetImageWidth(params), size_t(2)) - 1);
+    return params.center_on_pixel ? static_cast<double>(GetImageWidth(params) / 2) : columns / 2.0;
+}
+
+/** @brief Get the row of the image that the center of the view falls on.
+ * @param[in] params The render to measure.
+ * @returns The row, which is halfway between two pixels when the height is even unless the view is centered on a pixel.
+ */
+auto GetCenterRow(RenderParams const& params) -> double
+{
+    double rows = static_cast<double>(std::max(GetImageHeight(params), size_t(2)) - 1);
+    return params.center_on_pixel ? static_cast<double>(GetImageHeight(params) / 2) : rows / 2.0;
+}
+
+/** @brief Get the distance between neighboring pixels of a render in the complex plane.
+ *
+ * Pixels are square; at a zoom of 1 the unzoomed region just fits in whichever direction is tighter.
+ *
+ * @param[in] params The render to measure.
+ * @returns The pixel spacing.
+ */
+auto GetPixelStep(RenderParams const& params) -> double
+{
+    // distance between the first and last pixel centers in each direction
+    double columns = static_cast<double>(std::max(GetImageWidth(params), size_t(2)) - 1);
+    double rows = static_cast<double>(std::max(GetImageHeight(params), size_t(2)) - 1);
+
+    return std::max(k_unzoomed_real_extent / columns, k_unzoomed_imag_extent / rows) / params.zoom;
+}
+
+/** @brief Get the pixel to complex plane mapping of a render.
+ * @tparam T The floating point type the kernels iterate in.
+ * @param[in] params The render to map.
+ * @returns The viewport of the render, with the center of the whole image (see GetCenterColumn()) on the requested point.
+ */
+template <typename T>
+auto GetViewport(RenderParams const& params) -> Viewport<T>
+{
+    double step = GetPixelStep(params);
+
+    Viewport<T> viewport;
+    viewport.real_start = static_cast<T>(params.center_real - step * GetCenterColumn(params));
+    viewport.real_step = static_cast<T>(step);
+    viewport.imag_start = static_cast<T>(params.center_imag - step * GetCenterRow(params));
+    viewport.imag_step = static_cast<T>(step);
+    viewport.first_row = params.first_row;
+    viewport.first_column = params.first_column;
+    viewport.sample_stride = params.sample_stride;
+    viewport.sample_row = params.sample_row;
+    viewport.sample_column = params.sample_column;
+    return viewport;
+}
+
+/** @brief Decide whether a render needs to iterate in double precision.
+ *
+ * A float can only tell points apart down to its ulp at the magnitude of the coordinates; once neighboring pixels are
+ * less than k_min_ulps_per_pixel ulps apart, the image turns blocky and double precision is used instead.
+ *
+ * @param[in] params The render to check.
+ * @returns True if the kernels should iterate in double.
+ */
+auto UseDoublePrecision(RenderParams const& params) -> bool
+{
+    switch (params.precision)
+    {
+    case Precision::Single:
+        return false;
+    case Precision::Double:
+        return true;
+    case Precision::Auto:
+    default:
+    {
+        // the orbits of points in view stay within a radius of about 2 until they escape
+        double magnitude = std::max({std::abs(params.center_real), std::abs(params.center_imag), 2.0});
+        double float_ulp = magnitude * std::numeric_limits<float>::epsilon();
+        return GetPixelStep(params) < float_ulp * k_min_ulps_per_pixel;
+    }
+    }
+}
+
+/** @brief Decide whether a render is too deep for even double precision.
+ *
+ * Same test as UseDoublePrecision(), against the ulp of a double; such views need the perturbation engine.
+ *
+ * @param[in] params The render to check.
+ * @returns True if neighboring pixels are less than k_min_ulps_per_pixel double ulps apart.
+ */
+auto UsePerturbation(RenderParams const& params) -> bool
+{
+    double magnitude = std::max({std::abs(params.center_real), std::abs(params.center_imag), 2.0});
+    double double_ulp = magnitude * std::numeric_limits<double>::epsilon();
+    return GetPixelStep(params) < double_ulp * k_min_ulps_per_pixel;
+}
+
+/** @brief Call a function with the floating point type the kernels should iterate in.
+ * @param[in] params The render to check (see UseDoublePrecision()).
+ * @param[in] function The function to call, as function(T()) with T float or double.
+ * @returns Whatever the function returns.
+ */
+template <typename Function>
+auto WithPrecision(RenderParams const& params, Function&& function) -> decltype(auto)
+{
+    if (UseDoublePrecision(params))
+    {
+        return function(double());
+    }
+
+    return function(float());
+}
+
+/** @brief Resolve the iteration limit of a kernel instantiation.
+ * @tparam MaxIterations The limit baked into the instantiation, or k_dynamic_iterations.
+ * @param[in] max_iterations The limit requested at runtime.
+ * @returns MaxIterations if it is baked in, otherwise max_iterations.
+ */
+template <size_t MaxIterations>
+constexpr auto IterationLimit(size_t max_iterations) -> size_t
+{
+    return MaxIterations != k_dynamic_iterations ? MaxIterations : max_iterations;
+}
+
+/** @brief Call a function with the iteration limit as a compile-time constant when it is a common one.
+ *
+ * The kernels are templated on their iteration limit so that the common limits get loops with constant bounds; every
+ * other limit runs the k_dynamic_iterations instantiation, which reads the limit at runtime.
+ *
+ * @param[in] max_iterations The iteration limit of the render.
+ * @param[in] function The function to call, as function(std::integral_constant<size_t, MaxIterations>).
+ * @returns Whatever the function returns.
+ */
+template <typename Function>
+auto WithIterationLimit(size_t max_iterations, Function&& function) -> decltype(auto)
+{
+    switch (max_iterations)
+    {
+    case 100:
+        return function(std::integral_constant<size_t, 100>());
+    case 256:
+        return function(std::integral_constant<size_t, 256>());
+    case 1000:
+        return function(std::integral_constant<size_t, 1000>());
+    default:
+        return function(std::integral_constant<size_t, k_dynamic_iterations>());
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <Tensor.hpp>
+#include <ThreadPool.hpp>
+
+#include "Engine.hpp"
+#include "RenderParams.hpp"
+#include "Scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/*
+
+    reuse of the iteration counts of one frame of a zoom in the next
+
+    when a frame is the previous one magnified by an integer factor n about the same center, and the pixel grids line
+    up, every n-th row and column of the new frame lands on a pixel of the old one; the new frame is split into the
+    n x n lattices of every n-th pixel, the lattice that lands on old pixels is copied out of the previous frame, and
+    only the other n^2 - 1 are computed, each as an ordinary render with n times the pixel spacing, so every engine
+    supports it
+
+    the grids line up when the center of the frames sits on a pixel, or when n is odd: with the center halfway between
+    the middle two pixels of an even side, only odd factors line up, so animations center their frames on a pixel (see
+    RenderParams::center_on_pixel) and 2x steps line up at any size
+
+*/
+
+// the grids count as lined up while the pixels copied from the previous frame are off by at most this fraction of a
+// pixel (the zoom factor between frames is usually a power computed in floating point, so it is rarely exact)
+static constexpr double k_reprojection_tolerance = 1.0 / 64.0;
+
+// how the pixels of a frame line up with those of the previous one
+struct Reprojection
+{
+    size_t stride;          // the zoom factor between the frames; every stride-th pixel lands on an old one
+    size_t sample_row;      // the first row of the new frame that lands on an old row
+    size_t sample_column;   // the first column of the new frame that lands on an old column
+    size_t previous_row;    // the old row that sample_row lands on
+    size_t previous_column; // the old column that sample_column lands on
+};
+
+/** @brief Line up the pixels of one axis of a frame with those of the previous one.
+ * @param[in] side The length of the axis in pixels.
+ * @param[in] center The pixel the center of both frames falls on (see GetCenterColumn()), a whole or half number.
+ * @param[in] stride The zoom factor between the frames.
+ * @param[out] sample The first new pixel that lands on an old one.
+ * @param[out] previous The old pixel it lands on.
+ * @returns Whether any new pixel lands on an old one.
+ */
+auto GetReprojectionAxis(size_t side, double center, size_t stride, size_t& sample, size_t& previous) -> bool
+{
+    // new pixel i sits (i - center) / stride old pixels from the center, so it lands on old pixel (i + offset) / stride
+    // with offset = (stride - 1) * center, which has to be a whole number
+    size_t const doubled_offset = (stride - 1) * static_cast<size_t>(2.0 * center);
+    if (doubled_offset % 2 != 0)
+    {
+        return false;
+    }
+
+    size_t const offset = doubled_offset / 2;
+    sample = (stride - offset % stride) % stride;
+    previous = (sample + offset) / stride;
+    return sample < side;
+}
+
+/** @brief Decide whether a frame can reuse the pixels of the previous one.
+ * @param[in] previous_params The view of the previous frame.
+ * @param[in] params The view of the new frame.
+ * @param[out] reprojection How the new pixels line up with the old ones.
+ * @returns Whether the new frame magnifies the previous one by an integer factor of at least 2 with grids that line up.
+ */
+auto GetReprojection(RenderParams const& previous_params, RenderParams const& params, Reprojection& reprojection) -> bool
+{
+    auto is_whole_image = [](RenderParams const& view)
+    {
+        return view.image_height == 0 && view.image_width == 0 && view.first_row == 0 && view.first_column == 0 && view.sample_stride == 1;
+    };
+
+    bool same_view = previous_params.height == params.height && previous_params.width == params.width &&
+                     previous_params.center_real == params.center_real && previous_params.center_imag == params.center_imag &&
+                     previous_params.center_real_digits == params.center_real_digits && previous_params.center_imag_digits == params.center_imag_digits &&
+                     previous_params.center_on_pixel == params.center_on_pixel && previous_params.max_iterations == params.max_iterations &&
+                     previous_params.precision == params.precision;
+    if (!same_view || !is_whole_image(previous_params) || !is_whole_image(params))
+    {
+        return false;
+    }
+
+    double factor = GetPixelStep(previous_params) / GetPixelStep(params);
+    double stride = std::round(factor);
+    if (stride < 2.0 || stride > static_cast<double>(std::max(params.height, params.width)))
+    {
+        return false;
+    }
+
+    // the copied pixels drift furthest from where they belong at the edges of the frame
+    double drift = std::abs(factor / stride - 1.0) * static_cast<double>(std::max(params.height, params.width)) / 2.0;
+    if (drift > k_reprojection_tolerance)
+    {
+        return false;
+    }
+
+    reprojection.stride = static_cast<size_t>(stride);
+    return GetReprojectionAxis(params.height, GetCenterRow(params), reprojection.stride, reprojection.sample_row, reprojection.previous_row) &&
+           GetReprojectionAxis(params.width, GetCenterColumn(params), reprojection.stride, reprojection.sample_column, reprojection.previous_column);
+}
+
+/** @brief Compute the smoothed iteration counts of a frame, copying the pixels it shares with the previous frame.
+ *
+ * Falls back to a plain Compute() when the frames do not line up (see GetReprojection()).
+ *
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] previous The iteration counts of the previous frame.
+ * @param[in] previous_params The view of the previous frame.
+ * @param[in] params The view of the new frame.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads.
+ * @param[out] reused_pixels The number of pixels copied from the previous frame.
+ * @param[in] verbose Whether to print how the frame is being computed.
+ * @returns A 2D tensor (height x width) of smoothed iteration counts, ready to be passed to Colorize().
+ */
+auto ComputeReprojected(ThreadPool& pool, Engine engine, Tensor<float, 2> const& previous, RenderParams const& previous_params, RenderParams const& params, LaneMode lane_mode, size_t tile_size, size_t& reused_pixels, bool verbose = true) -> Tensor<float, 2>
+{
+    reused_pixels = 0;
+
+    Reprojection reprojection;
+    if (!GetReprojection(previous_params, params, reprojection))
+    {
+        return Compute(pool, engine, params, lane_mode, tile_size, verbose);
+    }
+
+    auto mandelbrot = Tensor<float, 2>({params.height, params.width});
+    auto const reference = PrepareReference(engine, params);
+    size_t const stride = reprojection.stride;
+
+    for (size_t row = 0; row < stride; ++row)
+    {
+        for (size_t column = 0; column < stride; ++column)
+        {
+            size_t const rows = (params.height - std::min(row, params.height) + stride - 1) / stride;
+            size_t const columns = (params.width - std::min(column, params.width) + stride - 1) / stride;
+            if (rows == 0 || columns == 0)
+            {
+                continue;
+            }
+
+            if (row == reprojection.sample_row && column == reprojection.sample_column)
+            {
+                DispatchTiles(pool, rows, columns, k_default_tile_size, [&](Tile const& tile)
+                {
+                    for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+                    {
+                        for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+                        {
+                            mandelbrot({row + y * stride, column + x * stride}) = previous({reprojection.previous_row + y, reprojection.previous_column + x});
+                        }
+                    }
+                });
+
+                reused_pixels = rows * columns;
+                continue;
+            }
+
+            // the engine is the same for every lattice, so it is only announced once
+            ComputeLattice(pool, engine, params, lane_mode, tile_size, reference, stride, row, column, mandelbrot, verbose);
+            verbose = false;
+        }
+    }
+
+    return mandelbrot;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+// a rectangular block of pixels, [y_begin, y_end) x [x_begin, x_end)
+struct Tile
+{
+    size_t y_begin;
+    size_t y_end;
+    size_t x_begin;
+    size_t x_end;
+};
+
+/** @brief Apply an operation to every tile of an image, handing tiles out to threads dynamically.
+ *
+ * The cost of a Mandelbrot pixel varies by orders of magnitude across the image, so splitting rows evenly between
+ * threads leaves most of them idle while the ones holding the set finish. Instead the image is cut into square tiles
+ * and every thread repeatedly claims the next unprocessed tile from a shared atomic counter until none are left.
+ *
+ * @param[in] pool The worker threads to run on.
+ * @param[in] height The height of the image.
+ * @param[in] width The width of the image.
+ * @param[in] tile_size The side length of the tiles (tiles on the bottom and right edges may be smaller).
+ * @param[in] function The operation to apply, called once per tile as function(Tile const&).
+ */
+template <typename Function>
+auto DispatchTiles(ThreadPool& pool, size_t height, size_t width, size_t tile_size, Function&& function) -> void
+{
+    tile_size = std::max(tile_size, size_t(1));
+
+    size_t tile_rows = (height + tile_size - 1) / tile_size;
+    size_t tile_columns = (width + tile_size - 1) / tile_size;
+    size_t tile_count = tile_rows * tile_columns;
+
+    std::atomic<size_t> next_tile = 0;
+
+    pool.Run([&](size_t)
+    {
+        for (size_t index = next_tile++; index < tile_count; index = next_tile++)
+        {
+            size_t y_begin = (index / tile_columns) * tile_size;
+            size_t x_begin = (index % tile_columns) * tile_size;
+            function(Tile{y_begin, std::min(y_begin + tile_size, height), x_begin, std::min(x_begin + tile_size, width)});
+        }
+    });
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <HttpServer.hpp>
+#include <LruCache.hpp>
+#include <PNG.hpp>
+#include <ThreadPool.hpp>
+
+#include "ColorMap.hpp"
+#include "Engine.hpp"
+#include "RenderParams.hpp"
+#include "Tiles.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+
+    serves the tile pyramid of Tiles.hpp over http, rendering each tile the first time it is asked for
+
+    encoded tiles are kept in an lru cache bounded by their total size, so panning back over a region is instant, and
+    requests that arrive for a tile while it is still being rendered wait for that render instead of starting another;
+    renders share the thread pool (one at a time, each spread over every worker) while the connections encode and send
+    in parallel
+
+*/
+
+// size of the tile cache when none is requested, in megabytes
+static constexpr size_t k_default_tile_cache_megabytes = 256;
+
+// largest ?iterations=N a request may ask for when none is given; renders run one at a time, so a single huge limit
+// would hold up every other tile
+static constexpr size_t k_default_served_iteration_limit = 100000;
+
+// what a served tile depends on besides the center, zoom, and engine the server was started with
+struct MapTileKey
+{
+    size_t level = 0;
+    size_t x = 0;
+    size_t y = 0;
+    size_t max_iterations = k_default_max_iterations;
+    Colormap colormap = Colormap::Magma;
+
+    auto operator==(MapTileKey const& other) const -> bool = default;
+};
+
+struct MapTileKeyHash
+{
+    auto operator()(MapTileKey const& key) const -> size_t
+    {
+        size_t hash = 0;
+        for (size_t value : {key.level, key.x, key.y, key.max_iterations, static_cast<size_t>(key.colormap)})
+        {
+            hash = hash * 1000003 ^ std::hash<size_t>()(value);
+        }
+        return hash;
+    }
+};
+
+/** @brief Parse a non-negative decimal integer that makes up all of the given text.
+ * @param[in] text The text to parse.
+ * @param[out] value The parsed value.
+ * @returns Whether the text was a valid number.
+ */
+auto ParseTileNumber(std::string const& text, size_t& value) -> bool
+{
+    if (text.empty() || text.size() > 18 || text.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+
+    value = std::stoull(text);
+    return true;
+}
+
+/** @brief Parse a tile request of the form /z/x/y.png, optionally followed by ?iterations=N and/or &colormap=NAME.
+ * @param[in] target The request target.
+ * @param[in] defaults The iteration limit and colormap to use when the query does not give them.
+ * @param[in] max_iterations The largest iteration limit the query may ask for.
+ * @param[out] key The requested tile.
+ * @returns The http status to answer with: 200 if the target names a tile that exists, 404 if its path names no tile,
+ * or 400 if its query asks for an invalid or too large iteration limit, or an unknown colormap.
+ */
+auto ParseMapTileTarget(std::string const& target, MapTileKey const& defaults, size_t max_iterations, MapTileKey& key) -> int
+{
+    key = defaults;
+
+    size_t query_start = target.find('?');
+    std::string path = target.substr(0, query_start);
+    std::string query = query_start == std::string::npos ? "" : target.substr(query_start + 1);
+
+    // path: /z/x/y.png
+    static std::string const k_extension = ".png";
+    if (path.size() < k_extension.size() || path.compare(path.size() - k_extension.size(), k_extension.size(), k_extension) != 0)
+    {
+        return 404;
+    }
+    path.resize(path.size() - k_extension.size());
+
+    std::string parts[3];
+    std::istringstream path_stream(path);
+    std::string empty;
+    if (!std::getline(path_stream, empty, '/') || !empty.empty())
+    {
+        return 404;
+    }
+    for (auto& part : parts)
+    {
+        if (!std::getline(path_stream, part, '/'))
+        {
+            return 404;
+        }
+    }
+
+    bool valid = path_stream.peek() == std::char_traits<char>::eof() && ParseTileNumber(parts[0], key.level) && ParseTileNumber(parts[1], key.x) && ParseTileNumber(parts[2], key.y);
+    if (!valid || key.level > k_max_map_levels || key.x >= (size_t(1) << key.level) || key.y >= (size_t(1) << key.level))
+    {
+        return 404;
+    }
+
+    // query: name=value pairs separated by &
+    std::istringstream query_stream(query);
+    std::string pair;
+    while (std::getline(query_stream, pair, '&'))
+    {
+        size_t equals = pair.find('=');
+        std::string name = pair.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : pair.substr(equals + 1);
+
+        if (name == "iterations")
+        {
+            if (!ParseTileNumber(value, key.max_iterations) || key.max_iterations == 0 || key.max_iterations > max_iterations)
+            {
+                return 400;
+            }
+        }
+        else if (name == "colormap")
+        {
+            if (!FindColormapByName(value, key.colormap))
+            {
+                return 400;
+            }
+        }
+    }
+
+    return 200;
+}
+
+/** @brief Serve the tiles of a pyramid on http://127.0.0.1:port/z/x/y.png until the process is stopped; this never
+ * returns.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The center, zoom, and default iteration limit of the pyramid.
+ * @param[in] colormap The default color palette.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads (not the map tiles).
+ * @param[in] port The port to listen on.
+ * @param[in] cache_bytes The total size of the encoded tiles to keep.
+ * @param[in] compression The deflate compression level.
+ * @param[in] max_served_iterations The largest iteration limit a request may ask for.
+ */
+[[noreturn]] auto ServeMapTiles(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, uint16_t port, size_t cache_bytes, int compression, size_t max_served_iterations) -> void
+{
+    LruCache<MapTileKey, std::string, MapTileKeyHash> cache(cache_bytes, [](std::string const& png) { return png.size(); });
+
+    MapTileKey defaults;
+    defaults.max_iterations = params.max_iterations;
+    defaults.colormap = colormap;
+
+    HttpServer server(port);
+    std::cout << "Serving tiles on http://127.0.0.1:" << server.Port() << "/{z}/{x}/{y}.png" << std::endl;
+
+    server.Serve([&](std::string const& target) -> HttpResponse
+    {
+        MapTileKey key;
+        int status = ParseMapTileTarget(target, defaults, max_served_iterations, key);
+        if (status == 404)
+        {
+            return {404, "text/plain", "no such tile; expected /z/x/y.png with optional ?iterations=N&colormap=NAME\n"};
+        }
+        if (status == 400)
+        {
+            return {400, "text/plain", "invalid query; iterations must be between 1 and " + std::to_string(max_served_iterations) + ", and colormap one of magma, twilight, or viridis\n"};
+        }
+
+        auto png = cache.GetOrCompute(key, [&]()
+        {
+            RenderParams tile_params = params;
+            tile_params.max_iterations = key.max_iterations;
+            auto tile = RenderMapTile(pool, engine, tile_params, key.colormap, lane_mode, tile_size, key.level, key.x, key.y);
+
+            std::ostringstream stream;
+            PngWriter writer(stream, k_map_tile_size, k_map_tile_size, compression);
+            writer.WriteRows(tile);
+            return stream.str();
+        });
+
+        return {200, "image/png", *png};
+    });
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <Expect.hpp>
+#include <PNG.hpp>
+#include <Tensor.hpp>
+#include <ThreadPool.hpp>
+
+#include "Colorize.hpp"
+#include "Engine.hpp"
+#include "RenderParams.hpp"
+#include "Scheduler.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/*
+
+    slippy map tile pyramids: level z covers the view with 2^z x 2^z tiles of 256 x 256 pixels, stored as
+    directory/z/x/y.png
+
+    only the finest level is rendered; it is computed in square windows of several tiles, so each window is one
+    Compute() call the tile scheduler spreads over every core, and each coarser level is made by averaging 2 x 2 blocks
+    of the level below it, which costs a tiny fraction of rendering it again and antialiases it for free; the pyramid
+    is built depth first, so only one window and a few tiles per level are ever held in memory
+
+*/
+
+// side length of a map tile in pixels
+static constexpr size_t k_map_tile_size = 256;
+
+// the finest level is rendered in windows 2^k_map_window_levels tiles on a side
+static constexpr size_t k_map_window_levels = 3;
+
+// deepest pyramid supported; pixel indices of the finest level have to fit comfortably in a size_t
+static constexpr size_t k_max_map_levels = 40;
+
+/** @brief Get the render parameters of a whole level of a tile pyramid.
+ *
+ * Level 0 is a single tile covering a square that the unzoomed view just fits in (magnified by the requested zoom).
+ * The pixels of every level are laid out so each one covers exactly the 2 x 2 pixels below it in the next level.
+ *
+ * @param[in] params The center, zoom, and iteration limit of the pyramid.
+ * @param[in] level The level to describe.
+ * @returns The parameters of the level as one square image.
+ */
+auto GetMapLevelParams(RenderParams const& params, size_t level) -> RenderParams
+{
+    size_t const side = k_map_tile_size << level;
+
+    RenderParams level_params = params;
+    level_params.width = side;
+    level_params.height = side;
+    level_params.image_width = 0;
+    level_params.image_height = 0;
+    level_params.first_row = 0;
+    level_params.first_column = 0;
+
+    // GetPixelStep() spreads the extent over side - 1 pixel gaps; pixel centers that nest across levels need the
+    // extent split into side equal cells instead
+    level_params.zoom = params.zoom * static_cast<double>(side) / static_cast<double>(side - 1);
+
+    return level_params;
+}
+
+/** @brief Get the render parameters of a square window of one level of a tile pyramid.
+ * @param[in] params The center, zoom, and iteration limit of the pyramid.
+ * @param[in] level The level the window is part of.
+ * @param[in] tile_x The column of the tile at the top left of the window, counted in windows of the same size.
+ * @param[in] tile_y The row of the tile at the top left of the window, counted in windows of the same size.
+ * @param[in] side The side length of the window in pixels.
+ * @returns The parameters of the window, which maps its pixels exactly like the whole level does.
+ */
+auto GetMapWindowParams(RenderParams const& params, size_t level, size_t tile_x, size_t tile_y, size_t side) -> RenderParams
+{
+    RenderParams window = GetMapLevelParams(params, level);
+    window.image_width = window.width;
+    window.image_height = window.height;
+    window.width = side;
+    window.height = side;
+    window.first_column = tile_x * side;
+    window.first_row = tile_y * side;
+    return window;
+}
+
+/** @brief Render a single map tile of a pyramid directly, without the levels below it.
+ * @param[in] pool The worker threads to render on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The center, zoom, and iteration limit of the pyramid.
+ * @param[in] colormap The color palette to use.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads (not the map tiles).
+ * @param[in] level The level of the tile.
+ * @param[in] tile_x The column of the tile within the level.
+ * @param[in] tile_y The row of the tile within the level.
+ * @returns A 3D tensor (256 x 256 x 3) representing an interleaved RGB tile.
+ */
+auto RenderMapTile(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, size_t level, size_t tile_x, size_t tile_y) -> Tensor<uint8_t, 3>
+{
+    RenderParams window = GetMapWindowParams(params, level, tile_x, tile_y, k_map_tile_size);
+    return Render(pool, engine, window, colormap, lane_mode, tile_size, false);
+}
+
+/** @brief Halve an image by averaging every 2 x 2 block of pixels.
+ * @param[in] pool The worker threads to run on.
+ * @param[in] image A 3D tensor (height x width x 3) with an even height and width.
+ * @returns The downsampled image.
+ */
+auto DownsampleImage(ThreadPool& pool, Tensor<uint8_t, 3> const& image) -> Tensor<uint8_t, 3>
+{
+    auto [height, width, channels] = image.Shape();
+    auto result = Tensor<uint8_t, 3>({height / 2, width / 2, channels});
+
+    DispatchTiles(pool, height / 2, width / 2, k_default_tile_size, [&](Tile const& tile)
+    {
+        for (size_t y = tile.y_begin; y < tile.y_end; ++y)
+        {
+            for (size_t x = tile.x_begin; x < tile.x_end; ++x)
+            {
+                for (size_t channel = 0; channel < channels; ++channel)
+                {
+                    uint32_t sum = image({2 * y, 2 * x, channel}) + image({2 * y, 2 * x + 1, channel}) + image({2 * y + 1, 2 * x, channel}) + image({2 * y + 1, 2 * x + 1, channel});
+                    result({y, x, channel}) = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    });
+
+    return result;
+}
+
+/** @brief Cut an image into map tiles and write them out, encoding one tile per worker at a time.
+ * @param[in] pool The worker threads to encode on.
+ * @param[in] image A 3D tensor whose height and width are multiples of k_map_tile_size.
+ * @param[in] directory The root directory of the pyramid.
+ * @param[in] level The level the image belongs to.
+ * @param[in] tile_x The column of the top left tile of the image within the level.
+ * @param[in] tile_y The row of the top left tile of the image within the level.
+ * @param[in] compression The deflate compression level.
+ */
+auto WriteMapTiles(ThreadPool& pool, Tensor<uint8_t, 3> const& image, std::string const& directory, size_t level, size_t tile_x, size_t tile_y, int compression) -> void
+{
+    auto [height, width, channels] = image.Shape();
+    size_t const rows = height / k_map_tile_size;
+    size_t const columns = width / k_map_tile_size;
+
+    // directories are created up front so the workers never race to create the same one
+    auto column_path = [&](size_t column)
+    {
+        return std::filesystem::path(directory) / std::to_string(level) / std::to_string(tile_x + column);
+    };
+    for (size_t column = 0; column < columns; ++column)
+    {
+        std::filesystem::create_directories(column_path(column));
+    }
+
+    std::atomic<size_t> next_tile = 0;
+
+    pool.Run([&](size_t)
+    {
+        auto tile = Tensor<uint8_t, 3>({k_map_tile_size, k_map_tile_size, channels});
+
+        for (size_t index = next_tile++; index < rows * columns; index = next_tile++)
+        {
+            size_t row = index / columns;
+            size_t column = index % columns;
+
+            for (size_t y = 0; y < k_map_tile_size; ++y)
+            {
+                uint8_t const* source = &image({row * k_map_tile_size + y, column * k_map_tile_size, 0});
+                std::copy(source, source + k_map_tile_size * channels, &tile({y, 0, 0}));
+            }
+
+            auto path = column_path(column) / (std::to_string(tile_y + row) + ".png");
+            PngWriter writer(path.string(), k_map_tile_size, k_map_tile_size, compression);
+            writer.WriteRows(tile);
+        }
+    });
+}
+
+// everything the recursive pyramid build needs that stays the same at every level
+struct MapPyramid
+{
+    ThreadPool& pool;
+    Engine engine;
+    RenderParams params;
+    Colormap colormap;
+    LaneMode lane_mode;
+    size_t tile_size;
+    size_t levels;
+    std::string directory;
+    int compression;
+    bool verbose;
+    std::optional<PerturbationReference> reference; // shared by every window of the finest level
+};
+
+/** @brief Build and write the tile of a pyramid at the given position, along with every tile below it.
+ * @param[in] pyramid The pyramid being built.
+ * @param[in] level The level of the tile.
+ * @param[in] tile_x The column of the tile within the level.
+ * @param[in] tile_y The row of the tile within the level.
+ * @returns The tile, for building the level above it.
+ */
+auto BuildMapTile(MapPyramid& pyramid, size_t level, size_t tile_x, size_t tile_y) -> Tensor<uint8_t, 3>
+{
+    size_t const depth = pyramid.levels - level;
+
+    if (depth <= k_map_window_levels)
+    {
+        // render the window of the finest level under this tile, then average it down level by level
+        size_t const side = k_map_tile_size << depth;
+
+        RenderParams window = GetMapWindowParams(pyramid.params, pyramid.levels, tile_x, tile_y, side);
+
+        // the engine is the same for every window, so it is only announced once
+        auto mandelbrot = ComputePart(pyramid.pool, pyramid.engine, window, pyramid.lane_mode, pyramid.tile_size, pyramid.reference, pyramid.verbose);
+        pyramid.verbose = false;
+
+        auto image = Colorize(pyramid.pool, mandelbrot, pyramid.colormap, pyramid.params.max_iterations);
+        for (size_t current = pyramid.levels;; --current)
+        {
+            size_t const scale = current - level;
+            WriteMapTiles(pyramid.pool, image, pyramid.directory, current, tile_x << scale, tile_y << scale, pyramid.compression);
+            if (current == level)
+            {
+                return image;
+            }
+            image = DownsampleImage(pyramid.pool, image);
+        }
+    }
+
+    // too deep for one window: assemble the four tiles below and average them
+    auto mosaic = Tensor<uint8_t, 3>({2 * k_map_tile_size, 2 * k_map_tile_size, 3});
+    for (size_t quadrant = 0; quadrant < 4; ++quadrant)
+    {
+        size_t const dx = quadrant % 2;
+        size_t const dy = quadrant / 2;
+        auto child = BuildMapTile(pyramid, level + 1, 2 * tile_x + dx, 2 * tile_y + dy);
+
+        for (size_t y = 0; y < k_map_tile_size; ++y)
+        {
+            std::copy(&child({y, 0, 0}), &child({y, 0, 0}) + k_map_tile_size * 3, &mosaic({dy * k_map_tile_size + y, dx * k_map_tile_size, 0}));
+        }
+    }
+
+    auto tile = DownsampleImage(pyramid.pool, mosaic);
+    WriteMapTiles(pyramid.pool, tile, pyramid.directory, level, tile_x, tile_y, pyramid.compression);
+    return tile;
+}
+
+/** @brief Render a slippy map tile pyramid into a directory tree.
+ * @param[in] pool The worker threads to render and encode on.
+ * @param[in] engine The rendering strategy to use.
+ * @param[in] params The center, zoom, and iteration limit of the pyramid (the width and height are ignored).
+ * @param[in] colormap The color palette to use.
+ * @param[in] lane_mode How the SIMD kernels assign pixels to vector lanes (brute force engine only).
+ * @param[in] tile_size The side length of the tiles handed out to threads (not the map tiles).
+ * @param[in] levels The finest level to render; levels 0 through levels are written.
+ * @param[in] directory The root directory of the pyramid, as directory/z/x/y.png.
+ * @param[in] compression The deflate compression level.
+ */
+auto RenderMapTiles(ThreadPool& pool, Engine engine, RenderParams const& params, Colormap colormap, LaneMode lane_mode, size_t tile_size, size_t levels, std::string const& directory, int compression) -> void
+{
+    Expect(levels <= k_max_map_levels, "error: at most " + std::to_string(k_max_map_levels) + " tile levels are supported");
+
+    MapPyramid pyramid{pool, engine, params, colormap, lane_mode, tile_size, levels, directory, compression, true, PrepareReference(engine, GetMapLevelParams(params, levels))};
+    BuildMapTile(pyramid, 0, 0, 0);
+}
@@ -1,19 +1,99 @@
 #include "argparse/argparse.hpp"
 
-#include <PNG.hpp>
+#include <Expect.hpp>
+#include <MappedFile.hpp>
 #include <Tensor.hpp>
+#include <ThreadPool.hpp>
 
+#include "Animate.hpp"
+#include "Colorize.hpp"
+#include "Engine.hpp"
 #include "Mandelbrot.hpp"
+#include "Output.hpp"
+#include "RenderParams.hpp"
+#include "Server.hpp"
+#include "Tiles.hpp"
 #include "Time.hpp"
 
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
 #include <sstream>
+#include <string>
+#include <vector>
+
+auto FormatCoordinate(double value) -> std::string
+{
+    std::ostringstream builder;
+    builder << value;
+    return builder.str();
+}
+
+auto ParseCoordinate(std::string const& text) -> double
+{
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    Expect(!text.empty() && *end == '\0' && std::isfinite(value), "error: invalid coordinate '" + text + "'");
+    return value;
+}
 
 auto Main(int argc, char** argv) -> int
 {
     argparse::ArgumentParser program("mandelbrot");
 
     program.add_argument("output")
-        .help("Path for the .png file to be saved");
+        .default_value(std::string("mandelbrot.png"))
+        .help("Path for the image to be saved; the extension picks the format (.png, .ppm, or .raw for bare rgb bytes)");
+
+    RenderParams defaults;
+
+    program.add_argument("--width")
+        .default_value(defaults.width)
+        .help("Width of the image in pixels")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("PIXELS");
+
+    program.add_argument("--height")
+        .default_value(defaults.height)
+        .help("Height of the image in pixels")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("PIXELS");
+
+    // the center is kept as text so deep zooms can give more digits than a double holds
+    program.add_argument("--real")
+        .default_value(FormatCoordinate(defaults.center_real))
+        .help("Real component of the point at the center of the image (any number of digits)")
+        .nargs(1)
+        .metavar("VALUE");
+
+    program.add_argument("--imag")
+        .default_value(FormatCoordinate(defaults.center_imag))
+        .help("Imaginary component of the point at the center of the image (any number of digits)")
+        .nargs(1)
+        .metavar("VALUE");
+
+    program.add_argument("-z", "--zoom")
+        .default_value(defaults.zoom)
+        .help("Magnification relative to the view of the whole set")
+        .nargs(1)
+        .scan<'g', double>()
+        .metavar("FACTOR");
+
+    program.add_argument("-i", "--iterations")
+        .default_value(defaults.max_iterations)
+        .help("Maximum number of iterations per pixel (100, 256, and 1000 run specialized kernels)")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("COUNT");
+
+    program.add_argument("-p", "--precision")
+        .default_value(std::string("auto"))
+        .help("Floating point type to iterate in: auto (double once float can no longer resolve neighboring pixels), single, or double")
+        .nargs(1)
+        .metavar("(auto|single|double)");
 
     program.add_argument("-c", "--colormap")
         .default_value(std::string("magma"))
@@ -21,6 +101,100 @@ auto Main(int argc, char** argv) -> int
         .nargs(1)
         .metavar("(magma|twilight|viridis)");
 
+    program.add_argument("-l", "--lanes")
+        .default_value(std::string("grouped"))
+        .help("How SIMD lanes are scheduled: grouped, or refill (reloads finished lanes; faster at high iteration counts)")
+        .nargs(1)
+        .metavar("(grouped|refill)");
+
+    program.add_argument("-e", "--engine")
+        .default_value(std::string("brute"))
+        .help("How the image is computed: brute (every pixel, widest SIMD kernel; switches to perturb past double precision), generic (every pixel, scalar kernel), subdivide (skips rectangles enclosed by the set), trace (boundary tracing), or perturb (deltas from a high precision reference orbit, for zooms past 1e13)")
+        .nargs(1)
+        .metavar("(brute|generic|subdivide|trace|perturb)");
+
+    program.add_argument("-t", "--tile-size")
+        .default_value(k_default_tile_size)
+        .help("Side length in pixels of the square tiles handed out to threads")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("PIXELS");
+
+    program.add_argument("-j", "--threads")
+        .default_value(size_t(0))
+        .help("Number of worker threads (0 for one per hardware thread)")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("COUNT");
+
+    program.add_argument("-b", "--band-height")
+        .default_value(size_t(0))
+        .help("Render and write the image this many rows at a time, so memory use follows the band instead of the image (0 renders it all at once)")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("ROWS");
+
+    program.add_argument("--compression")
+        .default_value(k_default_deflate_level)
+        .help("PNG compression level, from 0 (store only, fastest) to 9 (smallest)")
+        .nargs(1)
+        .scan<'i', int>()
+        .metavar("LEVEL");
+
+    program.add_argument("--tiles")
+        .help("Write a slippy map pyramid of 256x256 png tiles, levels 0 through LEVELS, into the output directory as z/x/y.png instead of a single image")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("LEVELS");
+
+    program.add_argument("--serve")
+        .help("Serve map tiles laid out like those of --tiles on http://127.0.0.1:PORT/z/x/y.png, rendering them on demand (the output path is ignored)")
+        .nargs(1)
+        .scan<'u', uint16_t>()
+        .metavar("PORT");
+
+    program.add_argument("--animate")
+        .help("Write FRAMES images zooming from 1 to --zoom on the center point, numbered after the output path (mandelbrot_0000.png, ...); frames are encoded while the next ones render, and whole-number zoom steps between frames (such as 2x, at any frame size) reuse the pixels they share")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("FRAMES");
+
+    program.add_argument("--encoders")
+        .default_value(k_default_animation_encoders)
+        .help("Threads encoding --animate frames; at most this many frames plus one wait to be written, which bounds memory use")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("COUNT");
+
+    program.add_argument("--cache-size")
+        .default_value(k_default_tile_cache_megabytes)
+        .help("Megabytes of encoded tiles --serve keeps in memory")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("MB");
+
+    program.add_argument("--serve-iterations")
+        .default_value(k_default_served_iteration_limit)
+        .help("Largest ?iterations=N a --serve request may ask for; larger ones are refused rather than holding up every other tile")
+        .nargs(1)
+        .scan<'u', size_t>()
+        .metavar("N");
+
+    program.add_argument("--mmap")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Map a .ppm or .raw output file into memory and colorize straight into it, skipping the image buffer; the image is computed in bands of --band-height rows (4 rows of tiles by default)");
+
+    program.add_argument("--progressive")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Render coarse to fine (every 8th pixel, then every 4th, 2nd, and all of them, each pass only computing the pixels the last one lacks) and report when each pass is ready; holds the whole image, so it cannot be combined with --mmap or --band-height");
+
+    program.add_argument("--pin")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Pin each worker thread to its own logical cpu");
+
     try
     {
         program.parse_args(argc, argv);
@@ -34,27 +208,234 @@ auto Main(int argc, char** argv) -> int
         throw std::runtime_error(builder.str());
     }
 
+    RenderParams params;
+    params.width          = program.get<size_t>("--width");
+    params.height         = program.get<size_t>("--height");
+    params.center_real    = ParseCoordinate(program.get<std::string>("--real"));
+    params.center_imag    = ParseCoordinate(program.get<std::string>("--imag"));
+    params.zoom           = program.get<double>("--zoom");
+    params.max_iterations = program.get<size_t>("--iterations");
+    params.precision      = GetPrecisionByName(program.get<std::string>("--precision"));
+
+    params.center_real_digits = program.get<std::string>("--real");
+    params.center_imag_digits = program.get<std::string>("--imag");
+
+    Expect(params.width > 0 && params.height > 0, "error: the image must be at least one pixel in each direction");
+    Expect(params.zoom > 0.0, "error: the zoom must be positive");
+    Expect(params.max_iterations > 0, "error: at least one iteration must be run");
+    Expect(params.max_iterations <= static_cast<size_t>(std::numeric_limits<int32_t>::max()),
+           "error: the iteration limit must fit the kernels' 32-bit counters");
+
     auto output_path   = program.get<std::string>("output");
     auto colormap_name = program.get<std::string>("--colormap");
+    auto lanes_name    = program.get<std::string>("--lanes");
+    auto engine_name   = program.get<std::string>("--engine");
+    auto tile_size     = program.get<size_t>("--tile-size");
+    auto thread_count  = program.get<size_t>("--threads");
+    auto pin_threads   = program.get<bool>("--pin");
+    auto band_height   = program.get<size_t>("--band-height");
+    auto compression   = program.get<int>("--compression");
+    auto use_mmap      = program.get<bool>("--mmap");
+    auto progressive   = program.get<bool>("--progressive");
+
+    Expect(compression >= 0 && compression <= 9, "error: the compression level must be between 0 and 9");
+
+    // each mode replaces the single image render, so asking for two of them would silently drop one
+    std::vector<std::string> modes;
+    std::string mode_names;
+    for (char const* mode : {"--tiles", "--serve", "--animate", "--progressive"})
+    {
+        if (program.is_used(mode))
+        {
+            mode_names += (modes.empty() ? "" : " and ") + std::string(mode);
+            modes.push_back(mode);
+        }
+    }
+    Expect(modes.size() <= 1, "error: " + mode_names + " are separate modes and cannot be combined");
+
+    // only the single image render streams bands or writes through a mapped file; every mode holds whole images
+    for (char const* option : {"--mmap", "--band-height"})
+    {
+        Expect(modes.empty() || !program.is_used(option), "error: " + std::string(option) + " cannot be combined with " + mode_names);
+    }
+    Expect(tile_size > 0, "error: tiles must be at least one pixel wide");
+
+    auto colormap  = GetColormapByName(colormap_name);
+    auto lane_mode = GetLaneModeByName(lanes_name);
+    auto engine    = GetEngineByName(engine_name);
+
+    // started once and reused by every render
+    ThreadPool pool(thread_count, pin_threads);
+
+    if (program.is_used("--serve"))
+    {
+        auto port = program.get<uint16_t>("--serve");
+        auto cache_megabytes = program.get<size_t>("--cache-size");
+        auto max_served_iterations = program.get<size_t>("--serve-iterations");
+
+        Expect(max_served_iterations <= static_cast<size_t>(std::numeric_limits<int32_t>::max()), "error: the served iteration limit must fit the kernels' 32-bit counters");
+        Expect(max_served_iterations >= params.max_iterations, "error: --iterations cannot exceed --serve-iterations");
+
+        ServeMapTiles(pool, engine, params, colormap, lane_mode, tile_size, port, cache_megabytes << 20, compression, max_served_iterations);
+    }
+
+    if (program.is_used("--tiles"))
+    {
+        auto levels = program.get<size_t>("--tiles");
+
+        auto elapsed = Time([&]()
+        {
+            RenderMapTiles(pool, engine, params, colormap, lane_mode, tile_size, levels, output_path, compression);
+        });
+
+        std::cout << "Tile Pyramid:          " << elapsed.count() << "s" << std::endl;
+
+        return 0;
+    }
+
+    auto format = GetImageFormatByPath(output_path);
+
+    if (program.is_used("--animate"))
+    {
+        auto frame_count = program.get<size_t>("--animate");
+        auto encoders = program.get<size_t>("--encoders");
+
+        auto [stats, total_elapsed] = Time([&]()
+        {
+            return RenderAnimation(pool, engine, params, colormap, lane_mode, tile_size, frame_count, output_path, format, compression, encoders);
+        });
+
+        // encoding overlaps rendering, so the total is less than the sum of the two
+        std::cout << "Rendering:             " << stats.rendering.count() << "s (" << 100.0 * static_cast<double>(stats.reused_pixels) / static_cast<double>(stats.total_pixels) << "% of pixels reused)" << std::endl;
+        std::cout << "Encoding:              " << stats.encoding.count() << "s" << std::endl;
+        std::cout << "Animation:             " << total_elapsed.count() << "s (" << static_cast<double>(frame_count) / total_elapsed.count() << " frames/s)" << std::endl;
+
+        return 0;
+    }
+
+    if (progressive)
+    {
+        auto start = chrono::high_resolution_clock::now();
+
+        // each pass is reported with the time from the start of the render until it was ready
+        auto mandelbrot = ComputeProgressive(pool, engine, params, lane_mode, tile_size, k_default_progressive_stride, [&](size_t stride, Tensor<float, 2> const&)
+        {
+            chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
 
-    auto colormap = GetColormapByName(colormap_name);
+            std::string label = stride > 1 ? "1/" + std::to_string(stride) + " Resolution:" : "Full Resolution:";
+            std::cout << label << std::string(label.size() < 23 ? 23 - label.size() : 1, ' ') << elapsed.count() << "s" << std::endl;
+        });
 
-    // 4k resolution
-    const size_t height = 2160;
-    const size_t width  = 3840;
+        auto [image, colorize_elapsed] = Time([&]()
+        {
+            return Colorize(pool, mandelbrot, colormap, params.max_iterations);
+        });
+
+        auto encode_elapsed = Time([&]()
+        {
+            WriteImage(pool, format, output_path, image, compression);
+        });
+
+        std::cout << "Colorization:          " << colorize_elapsed.count() << "s" << std::endl;
+        std::cout << "Encoding:              " << encode_elapsed.count() << "s" << std::endl;
+
+        return 0;
+    }
+
+    if (use_mmap && format == ImageFormat::Png)
+    {
+        std::cerr << "png output is compressed and cannot be written in place, ignoring --mmap" << std::endl;
+        use_mmap = false;
+    }
+
+    if (use_mmap)
+    {
+        // the iteration counts are computed a band at a time (a few rows of tiles unless --band-height is given), and
+        // each band is colorized directly into its rows of the mapped file, so no buffer of the whole image is allocated
+        size_t const mapped_band_height = band_height > 0 ? band_height : k_default_band_tiles * tile_size;
+
+        std::string header = GetImageHeader(format, params.width, params.height);
+        size_t const row_bytes = params.width * 3;
+
+        chrono::duration<double> colorize_elapsed(0.0);
+
+        auto total_elapsed = Time([&]()
+        {
+            MappedFile file(output_path, header.size() + params.height * row_bytes);
+            std::copy(header.begin(), header.end(), file.Data());
+            uint8_t* pixels = file.Data() + header.size();
+
+            ComputeBands(pool, engine, params, lane_mode, tile_size, mapped_band_height, [&](size_t first_row, Tensor<float, 2> const& band)
+            {
+                colorize_elapsed += Time([&]()
+                {
+                    ColorizeInto(pool, band, colormap, params.max_iterations, pixels + first_row * row_bytes);
+                });
+            });
+
+            file.Close();
+        });
+
+        std::cout << "Mandelbrot Generation: " << (total_elapsed - colorize_elapsed).count() << "s" << std::endl;
+        std::cout << "Colorization:          " << colorize_elapsed.count() << "s" << std::endl;
+
+        return 0;
+    }
+
+    if (band_height > 0)
+    {
+        chrono::duration<double> encode_elapsed(0.0);
+
+        auto write_bands = [&](auto& writer)
+        {
+            return Time([&]()
+            {
+                RenderBands(pool, engine, params, colormap, lane_mode, tile_size, band_height, [&](Tensor<uint8_t, 3> const& band)
+                {
+                    encode_elapsed += Time([&]()
+                    {
+                        writer.WriteRows(band);
+                    });
+                });
+            });
+        };
+
+        chrono::duration<double> total_elapsed;
+        if (format == ImageFormat::Png)
+        {
+            PngWriter writer(pool, output_path, params.width, params.height, compression);
+            total_elapsed = write_bands(writer);
+        }
+        else
+        {
+            RawImageWriter writer(output_path, params.width, params.height, GetImageHeader(format, params.width, params.height));
+            total_elapsed = write_bands(writer);
+        }
+
+        std::cout << "Rendering:             " << (total_elapsed - encode_elapsed).count() << "s" << std::endl;
+        std::cout << "Encoding:              " << encode_elapsed.count() << "s" << std::endl;
+
+        return 0;
+    }
 
     auto [mandelbrot, mandelbrot_elapsed] = Time([&]()
     {
-        return Mandelbrot(height, width, colormap);
+        return Compute(pool, engine, params, lane_mode, tile_size);
+    });
+
+    auto [image, colorize_elapsed] = Time([&]()
+    {
+        return Colorize(pool, mandelbrot, colormap, params.max_iterations);
     });
 
     auto encode_elapsed = Time([&]()
     {
-        EncodePng(output_path, mandelbrot);
+        WriteImage(pool, format, output_path, image, compression);
     });
 
     std::cout << "Mandelbrot Generation: " << mandelbrot_elapsed.count() << "s" << std::endl;
-    std::cout << "PNG Encoding:          " << encode_elapsed.count() << "s" << std::endl;
+    std::cout << "Colorization:          " << colorize_elapsed.count() << "s" << std::endl;
+    std::cout << "Encoding:              " << encode_elapsed.count() << "s" << std::endl;
 
     return 0;
 }
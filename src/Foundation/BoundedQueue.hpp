@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+/*
+
+    a first in, first out queue between threads that holds at most a fixed number of items
+
+    producers block while it is full, so a fast producer cannot run arbitrarily far ahead of its consumers (and pile up
+    memory); consumers block while it is empty, until the producer closes it
+
+*/
+
+template <typename T>
+class BoundedQueue
+{
+public:
+
+    /** @brief Create an empty queue.
+     * @param[in] capacity The most items the queue holds at once; must be at least 1.
+     */
+    explicit BoundedQueue(size_t capacity)
+        : m_capacity(capacity)
+        , m_closed(false)
+    {
+    }
+
+    /** @brief Add an item, waiting for room if the queue is full.
+     * @param[in] item The item to add.
+     */
+    auto Push(T item) -> void
+    {
+        std::unique_lock lock(m_mutex);
+        m_not_full.wait(lock, [&]()
+        {
+            return m_items.size() < m_capacity;
+        });
+
+        m_items.push_back(std::move(item));
+        lock.unlock();
+
+        m_not_empty.notify_one();
+    }
+
+    /** @brief Take the oldest item, waiting for one if the queue is empty.
+     * @returns The item, or nothing once the queue is closed and every item has been taken.
+     */
+    auto Pop() -> std::optional<T>
+    {
+        std::unique_lock lock(m_mutex);
+        m_not_empty.wait(lock, [&]()
+        {
+            return !m_items.empty() || m_closed;
+        });
+
+        if (m_items.empty())
+        {
+            return std::nullopt;
+        }
+
+        T item = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+
+        m_not_full.notify_one();
+        return item;
+    }
+
+    /** @brief Signal that no more items will be pushed; consumers drain what is left and then stop. */
+    auto Close() -> void
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+        }
+
+        m_not_empty.notify_all();
+    }
+
+private:
+
+    size_t m_capacity;
+    bool m_closed;
+    std::deque<T> m_items;
+
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+};
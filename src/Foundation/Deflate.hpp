@@ -0,0 +1,579 @@
+#pragma once
+
+#include "Expect.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/*
+
+    a raw deflate (rfc 1951) compressor that works on independent chunks of a larger stream
+
+    every chunk is compressed on its own, seeded with the 32 KiB of input that precede it so matches can still reach
+    back across the chunk boundary, and ends byte aligned (with a sync flush, or the final block of the stream); the
+    compressed chunks therefore concatenate into one valid stream in any order they are produced, so a stream can be
+    written out a piece at a time without ever holding all of its input
+
+*/
+
+// how far back a match may reach
+static constexpr size_t k_deflate_window = 32768;
+
+// compression level used when none is requested: 0 stores the input, 1 - 9 search ever longer for matches
+static constexpr int k_default_deflate_level = 6;
+
+// writes bits least significant first, as deflate packs them
+class DeflateBitWriter
+{
+public:
+
+    explicit DeflateBitWriter(std::vector<uint8_t>& output)
+        : m_output(output)
+        , m_bits(0)
+        , m_count(0)
+    {
+    }
+
+    auto Write(uint32_t value, size_t count) -> void
+    {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += count;
+        while (m_count >= 8)
+        {
+            m_output.push_back(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    // pads with zero bits up to the next byte boundary
+    auto Align() -> void
+    {
+        if (m_count > 0)
+        {
+            Write(0, 8 - m_count);
+        }
+    }
+
+private:
+
+    std::vector<uint8_t>& m_output;
+    uint64_t m_bits;
+    size_t m_count;
+};
+
+// a prefix code: the length and (bit reversed, ready to write) code of every symbol
+struct HuffmanCode
+{
+    std::vector<uint8_t> lengths;
+    std::vector<uint16_t> codes;
+};
+
+/** @brief Build a length limited huffman code for a set of symbol frequencies.
+ *
+ * Code lengths come from an ordinary huffman tree; lengths past the limit are then folded back in the way zlib and
+ * miniz do, by moving leaves up the tree until the code is complete again.
+ *
+ * @param[in] frequencies How often each symbol occurs.
+ * @param[in] max_length The longest code allowed.
+ * @returns A canonical code; symbols that never occur get no code, unless fewer than two occur.
+ */
+auto BuildHuffmanCode(std::vector<uint32_t> const& frequencies, size_t max_length) -> HuffmanCode
+{
+    size_t const symbol_count = frequencies.size();
+    HuffmanCode code{std::vector<uint8_t>(symbol_count, 0), std::vector<uint16_t>(symbol_count, 0)};
+
+    std::vector<size_t> used;
+    for (size_t symbol = 0; symbol < symbol_count; ++symbol)
+    {
+        if (frequencies[symbol] > 0)
+        {
+            used.push_back(symbol);
+        }
+    }
+
+    // pad out to two one bit codes; some decoders reject a code with a single symbol
+    if (used.size() < 2)
+    {
+        size_t first = used.empty() ? 0 : used[0];
+        code.lengths[first] = 1;
+        code.lengths[first == 0 ? 1 : 0] = 1;
+    }
+    else
+    {
+        // ordinary huffman tree; nodes past the leaves are internal, each recording its parent
+        std::vector<size_t> parent(2 * used.size() - 1, 0);
+        using Node = std::pair<uint64_t, size_t>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        for (size_t leaf = 0; leaf < used.size(); ++leaf)
+        {
+            queue.push({frequencies[used[leaf]], leaf});
+        }
+
+        size_t next_node = used.size();
+        while (queue.size() > 1)
+        {
+            auto [weight_a, node_a] = queue.top();
+            queue.pop();
+            auto [weight_b, node_b] = queue.top();
+            queue.pop();
+
+            parent[node_a] = next_node;
+            parent[node_b] = next_node;
+            queue.push({weight_a + weight_b, next_node++});
+        }
+
+        // depths of the leaves, walking down from the root (the last node)
+        std::vector<size_t> depth(parent.size(), 0);
+        for (size_t node = parent.size() - 1; node-- > 0;)
+        {
+            depth[node] = depth[parent[node]] + 1;
+        }
+
+        // count leaves per length, folding everything too long into the longest allowed length
+        std::vector<size_t> length_counts(max_length + 1, 0);
+        for (size_t leaf = 0; leaf < used.size(); ++leaf)
+        {
+            ++length_counts[std::min(depth[leaf], max_length)];
+        }
+
+        // the fold overfilled the code; split shorter leaves until the kraft sum is exactly one again
+        uint64_t kraft = 0;
+        for (size_t length = 1; length <= max_length; ++length)
+        {
+            kraft += static_cast<uint64_t>(length_counts[length]) << (max_length - length);
+        }
+        while (kraft > (uint64_t(1) << max_length))
+        {
+            --length_counts[max_length];
+            for (size_t length = max_length - 1; length > 0; --length)
+            {
+                if (length_counts[length] > 0)
+                {
+                    --length_counts[length];
+                    length_counts[length + 1] += 2;
+                    break;
+                }
+            }
+            --kraft;
+        }
+
+        // hand the shortest lengths to the most frequent symbols
+        std::stable_sort(used.begin(), used.end(), [&](size_t a, size_t b) { return frequencies[a] > frequencies[b]; });
+        size_t next_symbol = 0;
+        for (size_t length = 1; length <= max_length; ++length)
+        {
+            for (size_t count = 0; count < length_counts[length]; ++count)
+            {
+                code.lengths[used[next_symbol++]] = static_cast<uint8_t>(length);
+            }
+        }
+    }
+
+    // canonical codes (rfc 1951 section 3.2.2), bit reversed since huffman codes are packed most significant first
+    std::vector<size_t> length_counts(max_length + 1, 0);
+    for (uint8_t length : code.lengths)
+    {
+        ++length_counts[length];
+    }
+    length_counts[0] = 0;
+
+    std::vector<uint16_t> next_code(max_length + 1, 0);
+    uint16_t running = 0;
+    for (size_t length = 1; length <= max_length; ++length)
+    {
+        running = static_cast<uint16_t>((running + length_counts[length - 1]) << 1);
+        next_code[length] = running;
+    }
+
+    for (size_t symbol = 0; symbol < symbol_count; ++symbol)
+    {
+        size_t length = code.lengths[symbol];
+        if (length == 0)
+        {
+            continue;
+        }
+
+        uint16_t value = next_code[length]++;
+        uint16_t reversed = 0;
+        for (size_t bit = 0; bit < length; ++bit)
+        {
+            reversed = static_cast<uint16_t>((reversed << 1) | ((value >> bit) & 1));
+        }
+        code.codes[symbol] = reversed;
+    }
+
+    return code;
+}
+
+// a literal byte (distance 0) or a back reference
+struct DeflateToken
+{
+    uint16_t length_or_literal;
+    uint16_t distance;
+};
+
+// base values and extra bit counts of the length (257 - 285) and distance (0 - 29) symbols
+static constexpr std::array<uint16_t, 29> k_length_base = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr std::array<uint8_t, 29> k_length_extra = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr std::array<uint16_t, 30> k_distance_base = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static constexpr std::array<uint8_t, 30> k_distance_extra = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// order the code length code lengths are sent in
+static constexpr std::array<uint8_t, 19> k_code_length_order = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// finds the symbol whose base is the largest one not above value
+template <size_t N>
+auto DeflateSymbolIndex(std::array<uint16_t, N> const& bases, uint16_t value) -> size_t
+{
+    return static_cast<size_t>(std::upper_bound(bases.begin(), bases.end(), value) - bases.begin()) - 1;
+}
+
+/** @brief Write one block of tokens with its own dynamic huffman codes.
+ * @param[in,out] writer The bit stream to write the block into.
+ * @param[in] tokens The tokens of the block.
+ */
+auto WriteDynamicBlock(DeflateBitWriter& writer, std::vector<DeflateToken> const& tokens) -> void
+{
+    std::vector<uint32_t> literal_frequencies(286, 0);
+    std::vector<uint32_t> distance_frequencies(30, 0);
+    for (DeflateToken const& token : tokens)
+    {
+        if (token.distance == 0)
+        {
+            ++literal_frequencies[token.length_or_literal];
+        }
+        else
+        {
+            ++literal_frequencies[257 + DeflateSymbolIndex(k_length_base, token.length_or_literal)];
+            ++distance_frequencies[DeflateSymbolIndex(k_distance_base, token.distance)];
+        }
+    }
+    ++literal_frequencies[256];
+
+    HuffmanCode literal_code = BuildHuffmanCode(literal_frequencies, 15);
+    HuffmanCode distance_code = BuildHuffmanCode(distance_frequencies, 15);
+
+    // trailing unused codes are not sent
+    size_t literal_count = 286;
+    while (literal_count > 257 && literal_code.lengths[literal_count - 1] == 0)
+    {
+        --literal_count;
+    }
+    size_t distance_count = 30;
+    while (distance_count > 1 && distance_code.lengths[distance_count - 1] == 0)
+    {
+        --distance_count;
+    }
+
+    // run length encode both sets of code lengths as one sequence: (symbol, extra bits value)
+    std::vector<uint8_t> lengths(literal_code.lengths.begin(), literal_code.lengths.begin() + literal_count);
+    lengths.insert(lengths.end(), distance_code.lengths.begin(), distance_code.lengths.begin() + distance_count);
+
+    std::vector<std::pair<uint8_t, uint8_t>> runs;
+    for (size_t index = 0; index < lengths.size();)
+    {
+        uint8_t length = lengths[index];
+        size_t run = 1;
+        while (index + run < lengths.size() && lengths[index + run] == length)
+        {
+            ++run;
+        }
+
+        size_t remaining = run;
+        if (length == 0)
+        {
+            while (remaining >= 11)
+            {
+                size_t count = std::min(remaining, size_t(138));
+                runs.push_back({18, static_cast<uint8_t>(count - 11)});
+                remaining -= count;
+            }
+            if (remaining >= 3)
+            {
+                runs.push_back({17, static_cast<uint8_t>(remaining - 3)});
+                remaining = 0;
+            }
+        }
+        else
+        {
+            runs.push_back({length, 0});
+            --remaining;
+            while (remaining >= 3)
+            {
+                size_t count = std::min(remaining, size_t(6));
+                runs.push_back({16, static_cast<uint8_t>(count - 3)});
+                remaining -= count;
+            }
+        }
+        for (; remaining > 0; --remaining)
+        {
+            runs.push_back({length, 0});
+        }
+
+        index += run;
+    }
+
+    std::vector<uint32_t> code_length_frequencies(19, 0);
+    for (auto [symbol, extra] : runs)
+    {
+        ++code_length_frequencies[symbol];
+    }
+    HuffmanCode code_length_code = BuildHuffmanCode(code_length_frequencies, 7);
+
+    size_t code_length_count = 19;
+    while (code_length_count > 4 && code_length_code.lengths[k_code_length_order[code_length_count - 1]] == 0)
+    {
+        --code_length_count;
+    }
+
+    // block header: not final, dynamic codes
+    writer.Write(0, 1);
+    writer.Write(2, 2);
+    writer.Write(static_cast<uint32_t>(literal_count - 257), 5);
+    writer.Write(static_cast<uint32_t>(distance_count - 1), 5);
+    writer.Write(static_cast<uint32_t>(code_length_count - 4), 4);
+    for (size_t index = 0; index < code_length_count; ++index)
+    {
+        writer.Write(code_length_code.lengths[k_code_length_order[index]], 3);
+    }
+    for (auto [symbol, extra] : runs)
+    {
+        writer.Write(code_length_code.codes[symbol], code_length_code.lengths[symbol]);
+        if (symbol >= 16)
+        {
+            writer.Write(extra, symbol == 16 ? 2 : (symbol == 17 ? 3 : 7));
+        }
+    }
+
+    for (DeflateToken const& token : tokens)
+    {
+        if (token.distance == 0)
+        {
+            writer.Write(literal_code.codes[token.length_or_literal], literal_code.lengths[token.length_or_literal]);
+            continue;
+        }
+
+        size_t length_index = DeflateSymbolIndex(k_length_base, token.length_or_literal);
+        writer.Write(literal_code.codes[257 + length_index], literal_code.lengths[257 + length_index]);
+        writer.Write(token.length_or_literal - k_length_base[length_index], k_length_extra[length_index]);
+
+        size_t distance_index = DeflateSymbolIndex(k_distance_base, token.distance);
+        writer.Write(distance_code.codes[distance_index], distance_code.lengths[distance_index]);
+        writer.Write(token.distance - k_distance_base[distance_index], k_distance_extra[distance_index]);
+    }
+
+    writer.Write(literal_code.codes[256], literal_code.lengths[256]);
+}
+
+/** @brief Compress one chunk of a deflate stream.
+ * @param[in] dictionary The input that precedes the chunk in the stream (only its last k_deflate_window bytes are used).
+ * @param[in] dictionary_size The size of the dictionary in bytes.
+ * @param[in] data The input of the chunk.
+ * @param[in] size The size of the chunk in bytes.
+ * @param[in] last Whether the chunk ends the stream.
+ * @param[in] level The compression level (0 - 9).
+ * @returns The compressed chunk, ending on a byte boundary.
+ */
+auto DeflateChunk(uint8_t const* dictionary, size_t dictionary_size, uint8_t const* data, size_t size, bool last, int level = k_default_deflate_level) -> std::vector<uint8_t>
+{
+    Expect(level >= 0 && level <= 9, "error: compression level must be between 0 and 9");
+
+    std::vector<uint8_t> output;
+    DeflateBitWriter writer(output);
+
+    if (level == 0) // stored blocks of at most 65535 bytes
+    {
+        for (size_t offset = 0; offset < size; offset += 65535)
+        {
+            uint16_t length = static_cast<uint16_t>(std::min(size - offset, size_t(65535)));
+            writer.Write(0, 3);
+            writer.Align();
+            writer.Write(length, 16);
+            writer.Write(static_cast<uint16_t>(~length), 16);
+            output.insert(output.end(), data + offset, data + offset + length);
+        }
+    }
+    else
+    {
+        // how many earlier occurrences of a 3 byte prefix are tried per position
+        static constexpr std::array<size_t, 10> k_chain_lengths = {0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+        static constexpr size_t k_min_match = 3;
+        static constexpr size_t k_max_match = 258;
+        static constexpr size_t k_hash_bits = 15;
+        static constexpr size_t k_block_tokens = 1 << 16;
+
+        size_t const chain_length = k_chain_lengths[level];
+
+        // search the dictionary and the chunk as one buffer
+        size_t const history = std::min(dictionary_size, k_deflate_window);
+        std::vector<uint8_t> buffer(dictionary + dictionary_size - history, dictionary + dictionary_size);
+        buffer.insert(buffer.end(), data, data + size);
+
+        // hash chains: the most recent position of every hash, and the previous position with the same hash
+        std::vector<int64_t> head(size_t(1) << k_hash_bits, -1);
+        std::vector<int64_t> previous(k_deflate_window, -1);
+
+        auto hash = [&](size_t position) -> size_t
+        {
+            uint32_t value = (uint32_t(buffer[position]) << 16) | (uint32_t(buffer[position + 1]) << 8) | buffer[position + 2];
+            return (value * 2654435761u) >> (32 - k_hash_bits);
+        };
+        auto insert = [&](size_t position)
+        {
+            if (position + k_min_match <= buffer.size())
+            {
+                size_t key = hash(position);
+                previous[position % k_deflate_window] = head[key];
+                head[key] = static_cast<int64_t>(position);
+            }
+        };
+
+        for (size_t position = 0; position < history; ++position)
+        {
+            insert(position);
+        }
+
+        std::vector<DeflateToken> tokens;
+        tokens.reserve(std::min(size, k_block_tokens));
+
+        for (size_t position = history; position < buffer.size();)
+        {
+            size_t best_length = 0;
+            size_t best_distance = 0;
+
+            if (position + k_min_match <= buffer.size())
+            {
+                size_t max_length = std::min(k_max_match, buffer.size() - position);
+                int64_t candidate = head[hash(position)];
+                for (size_t tries = 0; tries < chain_length && candidate >= 0; ++tries)
+                {
+                    size_t distance = position - static_cast<size_t>(candidate);
+                    if (distance > k_deflate_window)
+                    {
+                        break;
+                    }
+
+                    size_t length = 0;
+                    while (length < max_length && buffer[static_cast<size_t>(candidate) + length] == buffer[position + length])
+                    {
+                        ++length;
+                    }
+                    if (length > best_length)
+                    {
+                        best_length = length;
+                        best_distance = distance;
+                        if (length == max_length)
+                        {
+                            break;
+                        }
+                    }
+
+                    // the slot may since have been reused by a position a whole window later
+                    int64_t next = previous[static_cast<size_t>(candidate) % k_deflate_window];
+                    if (next >= candidate)
+                    {
+                        break;
+                    }
+                    candidate = next;
+                }
+            }
+
+            if (best_length >= k_min_match)
+            {
+                tokens.push_back({static_cast<uint16_t>(best_length), static_cast<uint16_t>(best_distance)});
+                for (size_t offset = 0; offset < best_length; ++offset)
+                {
+                    insert(position + offset);
+                }
+                position += best_length;
+            }
+            else
+            {
+                tokens.push_back({buffer[position], 0});
+                insert(position);
+                ++position;
+            }
+
+            if (tokens.size() == k_block_tokens)
+            {
+                WriteDynamicBlock(writer, tokens);
+                tokens.clear();
+            }
+        }
+
+        if (!tokens.empty())
+        {
+            WriteDynamicBlock(writer, tokens);
+        }
+    }
+
+    if (last) // an empty final block with fixed codes: the header, then the 7 bit end of block code
+    {
+        writer.Write(1, 1);
+        writer.Write(1, 2);
+        writer.Write(0, 7);
+        writer.Align();
+    }
+    else // sync flush: an empty stored block brings the stream back to a byte boundary
+    {
+        writer.Write(0, 3);
+        writer.Align();
+        writer.Write(0x0000, 16);
+        writer.Write(0xffff, 16);
+    }
+
+    return output;
+}
+
+/** @brief Build the two byte zlib header of a deflate stream with a 32 KiB window.
+ * @param[in] level The compression level (0 - 9), recorded in the header the way zlib records it.
+ * @returns The header bytes.
+ */
+auto ZlibHeader(int level) -> std::array<uint8_t, 2>
+{
+    Expect(level >= 0 && level <= 9, "error: compression level must be between 0 and 9");
+
+    // FLEVEL: 0 fastest, 1 fast, 2 default, 3 maximum compression
+    uint32_t const flevel = level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3));
+
+    // CMF is deflate with a 32 KiB window; FCHECK makes the header a multiple of 31
+    uint32_t header = (0x78u << 8) | (flevel << 6);
+    header += (31 - header % 31) % 31;
+    return {static_cast<uint8_t>(header >> 8), static_cast<uint8_t>(header)};
+}
+
+/** @brief Update an adler-32 checksum (the zlib trailer) with more data.
+ * @param[in] adler The checksum so far (1 for no data).
+ * @param[in] data The data to add.
+ * @param[in] size The size of the data in bytes.
+ * @returns The updated checksum.
+ */
+auto Adler32(uint32_t adler, uint8_t const* data, size_t size) -> uint32_t
+{
+    static constexpr uint32_t k_modulus = 65521;
+    static constexpr size_t k_max_run = 5552; // longest run before the sums can overflow 32 bits
+
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        size_t run = std::min(size, k_max_run);
+        for (size_t index = 0; index < run; ++index)
+        {
+            a += data[index];
+            b += a;
+        }
+        a %= k_modulus;
+        b %= k_modulus;
+        data += run;
+        size -= run;
+    }
+
+    return (b << 16) | a;
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "Expect.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+
+    a signed fixed point number with a 32-bit integer part and any number of 32-bit fraction limbs
+
+    just enough arbitrary precision arithmetic to compute reference orbits for deep zooms: values stay small (the
+    integer part only has to hold a few hundred), so fixed point avoids all of the exponent bookkeeping a real
+    floating point bignum needs; operands must have the same number of fraction limbs
+
+    unlike a floating point number, the range and the resolution are both fixed: magnitudes must stay below 2^32 (a
+    conversion or result that would not throws std::overflow_error), and every value is a multiple of
+    2^(-32 * fraction limbs), so small values keep fewer significant bits than large ones
+
+*/
+
+class FixedPoint
+{
+public:
+
+    /** @brief Construct a zero.
+     * @param[in] fraction_limbs The number of 32-bit limbs after the binary point.
+     */
+    explicit FixedPoint(size_t fraction_limbs = 2)
+        : m_negative(false)
+        , m_limbs(fraction_limbs + 1, 0)
+    {
+    }
+
+    /** @brief Convert a double exactly (up to the precision of the fraction limbs).
+     * @param[in] value The value to convert; its magnitude must be below 2^32.
+     * @param[in] fraction_limbs The number of 32-bit limbs after the binary point.
+     * @returns The converted value.
+     */
+    static auto FromDouble(double value, size_t fraction_limbs) -> FixedPoint
+    {
+        Expect<std::overflow_error>(std::isfinite(value) && std::abs(value) < 4294967296.0, "error: value out of range for a fixed point number");
+
+        FixedPoint result(fraction_limbs);
+        result.m_negative = value < 0.0;
+
+        // peel off 32 bits at a time, most significant limb first; every step is exact
+        double remainder = std::abs(value);
+        for (size_t index = result.m_limbs.size(); index-- > 0;)
+        {
+            double limb = std::floor(remainder);
+            result.m_limbs[index] = static_cast<uint32_t>(limb);
+            remainder = (remainder - limb) * 4294967296.0;
+        }
+
+        return result;
+    }
+
+    /** @brief Parse a decimal number, such as "-0.743643887037158704752191506114774", "1.5e-3", or "2".
+     * @param[in] text The number to parse.
+     * @param[in] fraction_limbs The number of 32-bit limbs after the binary point.
+     * @returns The parsed value, rounded toward zero.
+     */
+    static auto FromString(std::string const& text, size_t fraction_limbs) -> FixedPoint
+    {
+        std::string const error = "error: invalid number '" + text + "'";
+
+        size_t position = 0;
+        bool negative = false;
+        if (position < text.size() && (text[position] == '-' || text[position] == '+'))
+        {
+            negative = text[position] == '-';
+            ++position;
+        }
+
+        // gather the significant digits and where the decimal point falls among them
+        std::string digits;
+        long point = -1;
+        for (; position < text.size(); ++position)
+        {
+            char character = text[position];
+            if (std::isdigit(static_cast<unsigned char>(character)))
+            {
+                digits.push_back(character);
+            }
+            else if (character == '.' && point < 0)
+            {
+                point = static_cast<long>(digits.size());
+            }
+            else
+            {
+                break;
+            }
+        }
+        Expect(!digits.empty(), error);
+        if (point < 0)
+        {
+            point = static_cast<long>(digits.size());
+        }
+
+        // an exponent moves the decimal point
+        if (position < text.size() && (text[position] == 'e' || text[position] == 'E'))
+        {
+            size_t consumed = 0;
+            try
+            {
+                point += std::stol(text.substr(position + 1), &consumed);
+            }
+            catch (std::exception const&)
+            {
+                Expect(false, error);
+            }
+            position += 1 + consumed;
+        }
+        Expect(position == text.size(), error);
+
+        // pad so the point falls within the digits
+        if (point < 0)
+        {
+            digits.insert(0, static_cast<size_t>(-point), '0');
+            point = 0;
+        }
+        if (point > static_cast<long>(digits.size()))
+        {
+            digits.append(static_cast<size_t>(point) - digits.size(), '0');
+        }
+
+        uint64_t integer = 0;
+        for (long index = 0; index < point; ++index)
+        {
+            integer = integer * 10 + static_cast<uint64_t>(digits[index] - '0');
+            Expect<std::overflow_error>(integer < 4294967296ull, "error: value out of range for a fixed point number");
+        }
+
+        // fold the fraction digits in from the least significant: fraction = (fraction + digit) / 10
+        FixedPoint result(fraction_limbs);
+        for (size_t index = digits.size(); index-- > static_cast<size_t>(point);)
+        {
+            result.m_limbs.back() = static_cast<uint32_t>(digits[index] - '0');
+            result.DivideMagnitude(10);
+        }
+        result.m_limbs.back() = static_cast<uint32_t>(integer);
+        result.m_negative = negative && !result.IsZero();
+
+        return result;
+    }
+
+    /** @brief Round to the nearest double.
+     * @returns The value as a double.
+     */
+    auto ToDouble() const -> double
+    {
+        double result = 0.0;
+        for (size_t index = 0; index < m_limbs.size(); ++index)
+        {
+            result += std::ldexp(static_cast<double>(m_limbs[index]), 32 * (static_cast<int>(index) - static_cast<int>(FractionLimbs())));
+        }
+
+        return m_negative ? -result : result;
+    }
+
+    auto FractionLimbs() const -> size_t
+    {
+        return m_limbs.size() - 1;
+    }
+
+    auto operator-() const -> FixedPoint
+    {
+        FixedPoint result = *this;
+        result.m_negative = !m_negative && !IsZero();
+        return result;
+    }
+
+    auto operator+(FixedPoint const& other) const -> FixedPoint
+    {
+        return AddSigned(other, other.m_negative);
+    }
+
+    auto operator-(FixedPoint const& other) const -> FixedPoint
+    {
+        return AddSigned(other, !other.m_negative);
+    }
+
+    /** @brief Multiply, truncating the product to the fraction limbs of the operands.
+     * @param[in] other The value to multiply by; the magnitude of the product must be below 2^32.
+     * @returns The product.
+     */
+    auto operator*(FixedPoint const& other) const -> FixedPoint
+    {
+        size_t const count = m_limbs.size();
+        std::vector<uint64_t> product(2 * count, 0);
+
+        // schoolbook multiplication with the carries propagated a row at a time
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < count; ++j)
+            {
+                uint64_t sum = product[i + j] + static_cast<uint64_t>(m_limbs[i]) * other.m_limbs[j] + carry;
+                product[i + j] = sum & 0xffffffffull;
+                carry = sum >> 32;
+            }
+            product[i + count] += carry;
+        }
+
+        // the binary point of the product sits FractionLimbs() limbs further up, so anything above the integer limb
+        // of the result is out of range
+        Expect<std::overflow_error>(std::all_of(product.begin() + static_cast<std::ptrdiff_t>(count + FractionLimbs()), product.end(), [](uint64_t limb) { return limb == 0; }), "error: fixed point product out of range");
+
+        FixedPoint result(FractionLimbs());
+        for (size_t index = 0; index < count; ++index)
+        {
+            result.m_limbs[index] = static_cast<uint32_t>(product[index + FractionLimbs()]);
+        }
+        result.m_negative = (m_negative != other.m_negative) && !result.IsZero();
+
+        return result;
+    }
+
+private:
+
+    auto IsZero() const -> bool
+    {
+        return std::all_of(m_limbs.begin(), m_limbs.end(), [](uint32_t limb) { return limb == 0; });
+    }
+
+    // compares magnitudes, returning -1, 0, or 1
+    auto CompareMagnitude(FixedPoint const& other) const -> int
+    {
+        for (size_t index = m_limbs.size(); index-- > 0;)
+        {
+            if (m_limbs[index] != other.m_limbs[index])
+            {
+                return m_limbs[index] < other.m_limbs[index] ? -1 : 1;
+            }
+        }
+
+        return 0;
+    }
+
+    // divides the magnitude by a small integer in place, truncating
+    auto DivideMagnitude(uint32_t divisor) -> void
+    {
+        uint64_t remainder = 0;
+        for (size_t index = m_limbs.size(); index-- > 0;)
+        {
+            uint64_t current = (remainder << 32) | m_limbs[index];
+            m_limbs[index] = static_cast<uint32_t>(current / divisor);
+            remainder = current % divisor;
+        }
+    }
+
+    // computes this + other, with other taken as negative if other_negative is set
+    auto AddSigned(FixedPoint const& other, bool other_negative) const -> FixedPoint
+    {
+        Expect(m_limbs.size() == other.m_limbs.size(), "error: fixed point operands differ in precision");
+
+        FixedPoint result(FractionLimbs());
+
+        if (m_negative == other_negative) // same sign: add magnitudes
+        {
+            uint64_t carry = 0;
+            for (size_t index = 0; index < m_limbs.size(); ++index)
+            {
+                uint64_t sum = static_cast<uint64_t>(m_limbs[index]) + other.m_limbs[index] + carry;
+                result.m_limbs[index] = static_cast<uint32_t>(sum);
+                carry = sum >> 32;
+            }
+            Expect<std::overflow_error>(carry == 0, "error: fixed point sum out of range");
+            result.m_negative = m_negative;
+        }
+        else // opposite signs: subtract the smaller magnitude from the larger
+        {
+            bool this_larger = CompareMagnitude(other) >= 0;
+            FixedPoint const& larger = this_larger ? *this : other;
+            FixedPoint const& smaller = this_larger ? other : *this;
+
+            int64_t borrow = 0;
+            for (size_t index = 0; index < m_limbs.size(); ++index)
+            {
+                int64_t difference = static_cast<int64_t>(larger.m_limbs[index]) - smaller.m_limbs[index] - borrow;
+                borrow = difference < 0;
+                result.m_limbs[index] = static_cast<uint32_t>(difference + (borrow << 32));
+            }
+            result.m_negative = this_larger ? m_negative : other_negative;
+        }
+
+        if (result.IsZero())
+        {
+            result.m_negative = false;
+        }
+
+        return result;
+    }
+
+    bool m_negative;               // sign of the value
+    std::vector<uint32_t> m_limbs; // magnitude, least significant limb first; the last limb is the integer part
+};
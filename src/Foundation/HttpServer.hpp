@@ -0,0 +1,286 @@
+#pragma once
+
+#include "BoundedQueue.hpp"
+#include "Expect.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+/*
+
+    a minimal http/1.1 server for local tools: it listens on the loopback interface only, answers GET and HEAD
+    requests, and closes every connection after one response
+
+    connections are answered by a fixed set of threads fed from a bounded queue, so a slow request does not hold up the
+    others while a burst of connections cannot start a thread each; once every thread is busy and the queue is full,
+    new connections wait in the listen backlog. the handler has to be safe to call from several threads at once
+
+*/
+
+struct HttpResponse
+{
+    int status = 200;
+    std::string content_type = "text/plain";
+    std::string body;
+};
+
+class HttpServer
+{
+public:
+
+    // the handler is given the request target (the path and query string) and returns the response to send
+    using Handler = std::function<HttpResponse(std::string const& target)>;
+
+    /** @brief Start listening on 127.0.0.1.
+     * @param[in] port The port to listen on, or 0 to let the operating system pick a free one (see Port()).
+     */
+    explicit HttpServer(uint16_t port)
+    {
+#if defined(_WIN32)
+        WSADATA data;
+        Expect(WSAStartup(MAKEWORD(2, 2), &data) == 0, "error: could not initialize sockets");
+#endif
+
+        m_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        Expect(m_listener != k_invalid_socket, "error: could not create a socket");
+
+        // restarting the server right away should not fail because the old socket is still winding down
+        int reuse = 1;
+        setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char const*>(&reuse), sizeof(reuse));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+
+        bool listening = bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && listen(m_listener, SOMAXCONN) == 0;
+        if (!listening)
+        {
+            CloseSocket(m_listener);
+            Expect(false, "error: could not listen on port " + std::to_string(port));
+        }
+
+        socklen_t length = sizeof(address);
+        getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &length);
+        m_port = ntohs(address.sin_port);
+    }
+
+    ~HttpServer()
+    {
+        CloseSocket(m_listener);
+#if defined(_WIN32)
+        WSACleanup();
+#endif
+    }
+
+    HttpServer(HttpServer const&) = delete;
+    auto operator=(HttpServer const&) -> HttpServer& = delete;
+
+    auto Port() const -> uint16_t
+    {
+        return m_port;
+    }
+
+    /** @brief Accept and answer connections forever; this never returns.
+     * @param[in] handler The function that answers every request.
+     * @param[in] thread_count The number of connections answered at once; must be at least 1.
+     */
+    [[noreturn]] auto Serve(Handler handler, size_t thread_count = k_default_connection_threads) -> void
+    {
+        Expect(thread_count > 0, "error: at least one thread must answer connections");
+
+        // accepted connections waiting for a thread; the threads run as long as the process does
+        BoundedQueue<Socket> connections(thread_count);
+        std::vector<std::thread> threads;
+        for (size_t index = 0; index < thread_count; ++index)
+        {
+            threads.emplace_back([&]()
+            {
+                while (auto connection = connections.Pop())
+                {
+                    HandleConnection(*connection, handler);
+                    CloseSocket(*connection);
+                }
+            });
+        }
+
+        for (;;)
+        {
+            Socket connection = accept(m_listener, nullptr, nullptr);
+            if (connection == k_invalid_socket)
+            {
+                // usually out of file descriptors; back off until connections close instead of spinning
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            connections.Push(connection);
+        }
+    }
+
+private:
+
+#if defined(_WIN32)
+    using Socket = SOCKET;
+    using socklen_t = int;
+    static constexpr Socket k_invalid_socket = INVALID_SOCKET;
+#else
+    using Socket = int;
+    static constexpr Socket k_invalid_socket = -1;
+#endif
+
+    // connections answered at once unless Serve() is told otherwise; map viewers keep about six requests in flight
+    static constexpr size_t k_default_connection_threads = 8;
+
+    // requests with headers larger than this are rejected
+    static constexpr size_t k_max_request_size = 16384;
+
+    // how long a connection may sit idle (sending or receiving) before it is dropped, in seconds
+    static constexpr int k_receive_timeout = 10;
+
+    static auto CloseSocket(Socket socket) -> void
+    {
+#if defined(_WIN32)
+        closesocket(socket);
+#else
+        close(socket);
+#endif
+    }
+
+    static auto SendAll(Socket socket, char const* data, size_t size) -> void
+    {
+#if defined(MSG_NOSIGNAL)
+        static constexpr int k_flags = MSG_NOSIGNAL; // a client hanging up must not kill the process with SIGPIPE
+#else
+        static constexpr int k_flags = 0;
+#endif
+
+        while (size > 0)
+        {
+            auto sent = send(socket, data, static_cast<int>(std::min(size, size_t(1) << 30)), k_flags);
+            if (sent <= 0)
+            {
+                return; // the client went away; nothing left to do
+            }
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+    }
+
+    static auto StatusText(int status) -> char const*
+    {
+        switch (status)
+        {
+        case 200:
+            return "OK";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        default:
+            return "Internal Server Error";
+        }
+    }
+
+    static auto HandleConnection(Socket connection, Handler const& handler) -> void
+    {
+#if defined(_WIN32)
+        DWORD timeout = k_receive_timeout * 1000;
+#else
+        timeval timeout = {k_receive_timeout, 0};
+#endif
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const*>(&timeout), sizeof(timeout));
+
+        // a client that stops reading would otherwise keep one of the few connection threads forever
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<char const*>(&timeout), sizeof(timeout));
+
+        // only the request line matters, but the headers have to be read before answering
+        std::string request;
+        while (request.find("\r\n\r\n") == std::string::npos)
+        {
+            char buffer[4096];
+            auto received = recv(connection, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                return;
+            }
+            request.append(buffer, static_cast<size_t>(received));
+
+            if (request.size() > k_max_request_size)
+            {
+                Respond(connection, {400, "text/plain", "request too large\n"}, false);
+                return;
+            }
+        }
+
+        // request line: METHOD TARGET VERSION
+        size_t method_end = request.find(' ');
+        size_t target_end = method_end == std::string::npos ? std::string::npos : request.find(' ', method_end + 1);
+        if (target_end == std::string::npos)
+        {
+            Respond(connection, {400, "text/plain", "malformed request\n"}, false);
+            return;
+        }
+
+        std::string method = request.substr(0, method_end);
+        std::string target = request.substr(method_end + 1, target_end - method_end - 1);
+
+        if (method != "GET" && method != "HEAD")
+        {
+            Respond(connection, {405, "text/plain", "only GET and HEAD are supported\n"}, false);
+            return;
+        }
+
+        HttpResponse response;
+        try
+        {
+            response = handler(target);
+        }
+        catch (std::exception const& e)
+        {
+            response = {500, "text/plain", std::string(e.what()) + "\n"};
+        }
+
+        Respond(connection, response, method == "HEAD");
+    }
+
+    static auto Respond(Socket connection, HttpResponse const& response, bool headers_only) -> void
+    {
+        std::string headers = "HTTP/1.1 " + std::to_string(response.status) + " " + StatusText(response.status) + "\r\n";
+        headers += "Content-Type: " + response.content_type + "\r\n";
+        headers += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+        headers += "Connection: close\r\n\r\n";
+
+        SendAll(connection, headers.data(), headers.size());
+        if (!headers_only)
+        {
+            SendAll(connection, response.body.data(), response.body.size());
+        }
+    }
+
+    Socket m_listener;
+    uint16_t m_port;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/*
+
+    a thread safe cache bounded by the total size of its values, evicting the least recently used entries first
+
+    values are computed on a miss by the caller that missed, outside the lock, so lookups of other keys never wait on
+    a computation; a caller that misses on a key another caller is already computing waits for that result instead of
+    computing it a second time
+
+*/
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+
+    using ValuePointer = std::shared_ptr<Value const>;
+
+    /** @brief Create an empty cache.
+     * @param[in] capacity The total size the values may add up to before old ones are evicted.
+     * @param[in] measure The size of a value, called as measure(Value const&).
+     */
+    LruCache(size_t capacity, std::function<size_t(Value const&)> measure)
+        : m_capacity(capacity)
+        , m_measure(std::move(measure))
+        , m_size(0)
+    {
+    }
+
+    /** @brief Look up a value, computing it on a miss.
+     *
+     * Concurrent calls for the same missing key are coalesced: only the first runs compute, the rest wait for it. If
+     * compute throws, every waiting caller sees the exception and nothing is cached.
+     *
+     * @param[in] key The key to look up.
+     * @param[in] compute The function that produces the value on a miss, called as compute() -> Value.
+     * @returns The cached or computed value.
+     */
+    template <typename Compute>
+    auto GetOrCompute(Key const& key, Compute&& compute) -> ValuePointer
+    {
+        std::unique_lock lock(m_mutex);
+
+        if (auto found = m_index.find(key); found != m_index.end())
+        {
+            // most recently used entries are kept at the front
+            m_entries.splice(m_entries.begin(), m_entries, found->second);
+            return found->second->second;
+        }
+
+        if (auto pending = m_pending.find(key); pending != m_pending.end())
+        {
+            auto result = pending->second;
+            lock.unlock();
+            return result.get();
+        }
+
+        std::promise<ValuePointer> promise;
+        m_pending.emplace(key, promise.get_future().share());
+        lock.unlock();
+
+        ValuePointer value;
+        try
+        {
+            value = std::make_shared<Value const>(compute());
+        }
+        catch (...)
+        {
+            lock.lock();
+            m_pending.erase(key);
+            lock.unlock();
+
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        lock.lock();
+        m_pending.erase(key);
+        Insert(key, value);
+        lock.unlock();
+
+        promise.set_value(value);
+        return value;
+    }
+
+    /** @brief Get the total size of the cached values.
+     * @returns The sum of the sizes of every value held.
+     */
+    auto Size() -> size_t
+    {
+        std::lock_guard lock(m_mutex);
+        return m_size;
+    }
+
+private:
+
+    // adds an entry and evicts from the back until the cache fits; expects the lock to be held
+    auto Insert(Key const& key, ValuePointer const& value) -> void
+    {
+        size_t size = m_measure(*value);
+        if (size > m_capacity)
+        {
+            return; // would evict everything and still not fit
+        }
+
+        m_entries.emplace_front(key, value);
+        m_index[key] = m_entries.begin();
+        m_size += size;
+
+        while (m_size > m_capacity)
+        {
+            auto& oldest = m_entries.back();
+            m_size -= m_measure(*oldest.second);
+            m_index.erase(oldest.first);
+            m_entries.pop_back();
+        }
+    }
+
+    using Entry = std::pair<Key, ValuePointer>;
+
+    size_t m_capacity;
+    std::function<size_t(Value const&)> m_measure;
+
+    std::mutex m_mutex;
+    size_t m_size;                                                               // sum of the sizes of the entries
+    std::list<Entry> m_entries;                                                  // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> m_index;  // where each key sits in m_entries
+    std::unordered_map<Key, std::shared_future<ValuePointer>, Hash> m_pending;  // keys being computed right now
+};
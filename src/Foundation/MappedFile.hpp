@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Expect.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+
+    a file of a fixed size mapped into memory for writing
+
+    whatever is stored through Data() lands in the page cache directly and is written back by the operating system, so
+    output produced in place skips both the intermediate buffer and the copy into the file; only regular files can be
+    mapped (not pipes or terminals)
+
+    the space of the file is reserved up front where the platform allows it, so a full disk is reported when the file is
+    created rather than as a bus error on the first store to an unbacked page; Close() waits for the pages to reach the
+    file and reports whether they did
+
+*/
+
+class MappedFile
+{
+public:
+
+    /** @brief Create (or truncate) a file of the given size and map all of it for writing.
+     * @param[in] filename The path of the file.
+     * @param[in] size The size of the file in bytes; must be greater than zero.
+     */
+    MappedFile(std::string const& filename, size_t size)
+        : m_filename(filename)
+        , m_size(size)
+    {
+        Expect(size > 0, "error: cannot map an empty file");
+
+#if defined(_WIN32)
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        Expect(m_file != INVALID_HANDLE_VALUE, "error: could not open " + filename + " for writing");
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(uint64_t(size) >> 32), static_cast<DWORD>(size), nullptr);
+        if (m_mapping == nullptr)
+        {
+            CloseHandle(m_file);
+            Expect(false, "error: could not map " + filename);
+        }
+
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size));
+        if (m_data == nullptr)
+        {
+            CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            Expect(false, "error: could not map " + filename);
+        }
+#else
+        m_file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        Expect(m_file >= 0, "error: could not open " + filename + " for writing");
+
+        // the file has to be grown to its final size before the pages past its end can be mapped; macos has no
+        // posix_fallocate, so there the blocks are only allocated as the pages are written back
+#if defined(__APPLE__)
+        bool resized = ftruncate(m_file, static_cast<off_t>(size)) == 0;
+#else
+        bool resized = posix_fallocate(m_file, 0, static_cast<off_t>(size)) == 0;
+#endif
+        if (!resized)
+        {
+            close(m_file);
+            Expect(false, "error: could not allocate " + std::to_string(size) + " bytes for " + filename);
+        }
+
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(m_file);
+            Expect(false, "error: could not map " + filename);
+        }
+        m_data = static_cast<uint8_t*>(data);
+#endif
+    }
+
+    /** @brief Unmap the file if Close() was not called; the operating system writes back whatever has not been
+     * flushed yet, and any failure to do so goes unreported.
+     */
+    ~MappedFile()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+#if defined(_WIN32)
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(m_data, m_size);
+        close(m_file);
+#endif
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    auto operator=(MappedFile const&) -> MappedFile& = delete;
+
+    auto Data() -> uint8_t*
+    {
+        return m_data;
+    }
+
+    auto Size() const -> size_t
+    {
+        return m_size;
+    }
+
+    /** @brief Write the mapped pages back to the file, wait for them to get there, and unmap it; Data() is invalid
+     * afterwards.
+     */
+    auto Close() -> void
+    {
+        Expect(m_data != nullptr, "error: " + m_filename + " is already closed");
+        uint8_t* data = std::exchange(m_data, nullptr);
+
+#if defined(_WIN32)
+        bool flushed = FlushViewOfFile(data, 0) && FlushFileBuffers(m_file);
+        bool unmapped = UnmapViewOfFile(data);
+        bool closed = CloseHandle(m_mapping) && CloseHandle(m_file);
+#else
+        bool flushed = msync(data, m_size, MS_SYNC) == 0;
+        bool unmapped = munmap(data, m_size) == 0;
+        bool closed = close(m_file) == 0;
+#endif
+
+        Expect(flushed, "error: could not write " + m_filename);
+        Expect(unmapped && closed, "error: could not close " + m_filename);
+    }
+
+private:
+
+#if defined(_WIN32)
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_file;
+#endif
+    std::string m_filename;
+    uint8_t* m_data;
+    size_t m_size;
+};
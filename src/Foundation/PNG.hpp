@@ -1,17 +1,387 @@
 #pragma once
 
 #include <Tensor.hpp>
-#include <lodepng.h>
 
+#include "Deflate.hpp"
 #include "Expect.hpp"
+#include "ThreadPool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
 
-auto EncodePng(const std::string& filename, Tensor<uint8_t, 3> const& rgb) -> void
+// largest IDAT chunk written; the format allows up to 2^31 - 1 bytes, but a band of a large image at a low compression
+// level can exceed that, so the compressed data of each band is split into chunks of this size
+static constexpr size_t k_max_png_chunk_size = size_t(1) << 20;
+
+/** @brief Update a crc-32 checksum (the png chunk trailer) with more data.
+ * @param[in] crc The checksum so far (0 for no data).
+ * @param[in] data The data to add.
+ * @param[in] size The size of the data in bytes.
+ * @returns The updated checksum.
+ */
+auto Crc32(uint32_t crc, uint8_t const* data, size_t size) -> uint32_t
+{
+    static std::array<uint32_t, 256> const k_table = []()
+    {
+        std::array<uint32_t, 256> table;
+        for (uint32_t index = 0; index < 256; ++index)
+        {
+            uint32_t value = index;
+            for (size_t bit = 0; bit < 8; ++bit)
+            {
+                value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            }
+            table[index] = value;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (size_t index = 0; index < size; ++index)
+    {
+        crc = k_table[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/*
+
+    writes an rgb png a band of rows at a time, so an image never has to be held in memory all at once
+
+    every band is filtered and compressed as soon as it arrives and goes out as its own IDAT chunk; the deflate stream
+    runs on across chunks (see DeflateChunk()), carrying the last 32 KiB of filtered rows and the previous row over
+
+    the work within a band is spread over a thread pool the way pigz does it: rows are filtered in parallel (each only
+    needs the unfiltered row above it), then the filtered band is cut into fixed size pieces that are deflated in
+    parallel, each seeded with the 32 KiB before it, and joined in order
+
+*/
+
+class PngWriter
+{
+public:
+
+    /** @brief Create the file and write the png header.
+     * @param[in] pool The worker threads to filter and compress on.
+     * @param[in] filename The path to write to.
+     * @param[in] width The width of the image in pixels.
+     * @param[in] height The height of the image in pixels.
+     * @param[in] level The deflate compression level (0 - 9).
+     */
+    PngWriter(ThreadPool& pool, std::string const& filename, size_t width, size_t height, int level = k_default_deflate_level)
+        : PngWriter(&pool, nullptr, filename, width, height, level)
+    {
+    }
+
+    /** @brief Create the file and write the png header; the image is encoded on the calling thread alone.
+     *
+     * For encoding many small images at once, such as from the workers of a thread pool.
+     *
+     * @param[in] filename The path to write to.
+     * @param[in] width The width of the image in pixels.
+     * @param[in] height The height of the image in pixels.
+     * @param[in] level The deflate compression level (0 - 9).
+     */
+    PngWriter(std::string const& filename, size_t width, size_t height, int level = k_default_deflate_level)
+        : PngWriter(nullptr, nullptr, filename, width, height, level)
+    {
+    }
+
+    /** @brief Write the png header to a stream, such as a std::ostringstream for encoding in memory; the image is
+     * encoded on the calling thread alone.
+     * @param[in] stream The stream to write to; it must outlive the writer.
+     * @param[in] width The width of the image in pixels.
+     * @param[in] height The height of the image in pixels.
+     * @param[in] level The deflate compression level (0 - 9).
+     */
+    PngWriter(std::ostream& stream, size_t width, size_t height, int level = k_default_deflate_level)
+        : PngWriter(nullptr, &stream, "", width, height, level)
+    {
+    }
+
+    /** @brief Filter, compress, and write the next band of rows; the file is finished once the last row is written.
+     * @param[in] rows A 3D tensor (rows x width x 3) representing an interleaved RGB band of the image.
+     */
+    auto WriteRows(Tensor<uint8_t, 3> const& rows) -> void
+    {
+        auto [row_count, width, channels] = rows.Shape();
+        Expect(channels == 3 && width == m_width, "error: band does not match the width of the png");
+        Expect(row_count > 0 && m_rows_written + row_count <= m_height, "error: band does not fit in the rows left in the png");
+
+        size_t const stride = m_width * 3;
+        size_t const scanline = stride + 1; // a filter type byte followed by the filtered row
+        size_t const size = row_count * scanline;
+
+        // the filtered band goes right after the dictionary, so the input before any piece is one contiguous buffer
+        std::vector<uint8_t> stream(m_dictionary.size() + size);
+        std::copy(m_dictionary.begin(), m_dictionary.end(), stream.begin());
+        uint8_t* filtered = stream.data() + m_dictionary.size();
+
+        size_t const block_count = (row_count + k_filter_block_rows - 1) / k_filter_block_rows;
+        ForEach(block_count, [&](size_t block)
+        {
+            size_t const end = std::min((block + 1) * k_filter_block_rows, row_count);
+            for (size_t y = block * k_filter_block_rows; y < end; ++y)
+            {
+                uint8_t const* above = y > 0 ? &rows({y - 1, 0, 0}) : m_previous_row.data();
+                FilterRow(&rows({y, 0, 0}), above, filtered + y * scanline);
+            }
+        });
+        m_previous_row.assign(&rows({row_count - 1, 0, 0}), &rows({row_count - 1, 0, 0}) + stride);
+
+        bool first = m_rows_written == 0;
+        m_rows_written += row_count;
+        bool last = m_rows_written == m_height;
+
+        size_t const piece_count = (size + k_piece_size - 1) / k_piece_size;
+        std::vector<std::vector<uint8_t>> pieces(piece_count);
+        ForEach(piece_count, [&](size_t piece)
+        {
+            size_t const begin = piece * k_piece_size;
+            size_t const end = std::min(begin + k_piece_size, size);
+            pieces[piece] = DeflateChunk(stream.data(), m_dictionary.size() + begin, filtered + begin, end - begin, last && piece + 1 == piece_count, m_level);
+        });
+
+        std::vector<uint8_t> data;
+        if (first)
+        {
+            auto header = ZlibHeader(m_level);
+            data.assign(header.begin(), header.end());
+        }
+
+        for (auto const& piece : pieces)
+        {
+            data.insert(data.end(), piece.begin(), piece.end());
+        }
+
+        m_adler = Adler32(m_adler, filtered, size);
+        if (last)
+        {
+            AppendBigEndian(data, m_adler);
+        }
+
+        // keep the tail of the stream as the dictionary of the next band
+        m_dictionary.assign(stream.end() - static_cast<std::ptrdiff_t>(std::min(stream.size(), k_deflate_window)), stream.end());
+
+        // a band with no new compressed data still gets its (empty) chunk
+        size_t offset = 0;
+        do
+        {
+            size_t size = std::min(data.size() - offset, k_max_png_chunk_size);
+            WriteChunk("IDAT", data.data() + offset, size);
+            offset += size;
+        }
+        while (offset < data.size());
+
+        if (last)
+        {
+            WriteChunk("IEND", nullptr, 0);
+            m_stream->flush();
+            if (m_file.is_open())
+            {
+                m_file.close();
+            }
+            Expect(m_stream->good() && !m_file.fail(), "error: failed to write png");
+        }
+    }
+
+private:
+
+    // writes to the stream if one is given, and to a new file otherwise
+    PngWriter(ThreadPool* pool, std::ostream* stream, std::string const& filename, size_t width, size_t height, int level)
+        : m_pool(pool)
+        , m_stream(stream)
+        , m_width(width)
+        , m_height(height)
+        , m_level(level)
+        , m_rows_written(0)
+        , m_adler(1)
+        , m_previous_row(width * 3, 0)
+    {
+        if (m_stream == nullptr)
+        {
+            m_file.open(filename, std::ios::binary);
+            Expect(m_file.good(), "error: could not open " + filename + " for writing");
+            m_stream = &m_file;
+        }
+        Expect(width > 0 && height > 0 && width < (1u << 31) && height < (1u << 31), "error: invalid png dimensions");
+
+        static constexpr uint8_t k_signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        m_stream->write(reinterpret_cast<char const*>(k_signature), sizeof(k_signature));
+
+        // 8 bits per channel, rgb, default compression, filter, and no interlacing
+        std::vector<uint8_t> header;
+        AppendBigEndian(header, static_cast<uint32_t>(width));
+        AppendBigEndian(header, static_cast<uint32_t>(height));
+        header.insert(header.end(), {8, 2, 0, 0, 0});
+        WriteChunk("IHDR", header.data(), header.size());
+    }
+
+    // rows filtered per task, and filtered bytes deflated per task (pigz uses the same 128 KiB)
+    static constexpr size_t k_filter_block_rows = 16;
+    static constexpr size_t k_piece_size = 131072;
+
+    // calls function(index) for every index below count, spread over the pool if there is one
+    template <typename Function>
+    auto ForEach(size_t count, Function&& function) -> void
+    {
+        if (m_pool == nullptr)
+        {
+            for (size_t index = 0; index < count; ++index)
+            {
+                function(index);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next = 0;
+
+        m_pool->Run([&](size_t)
+        {
+            for (size_t index = next++; index < count; index = next++)
+            {
+                function(index);
+            }
+        });
+    }
+
+    static auto AppendBigEndian(std::vector<uint8_t>& output, uint32_t value) -> void
+    {
+        output.insert(output.end(), {static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)});
+    }
+
+    auto WriteChunk(char const (&type)[5], uint8_t const* data, size_t size) -> void
+    {
+        Expect(size < (size_t(1) << 31), "internal error: png chunk too large");
+
+        // length and type, then the data, then the crc of the type and data
+        std::vector<uint8_t> header;
+        AppendBigEndian(header, static_cast<uint32_t>(size));
+        header.insert(header.end(), type, type + 4);
+
+        std::vector<uint8_t> trailer;
+        AppendBigEndian(trailer, Crc32(Crc32(0, header.data() + 4, 4), data, size));
+
+        m_stream->write(reinterpret_cast<char const*>(header.data()), static_cast<std::streamsize>(header.size()));
+        m_stream->write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+        m_stream->write(reinterpret_cast<char const*>(trailer.data()), static_cast<std::streamsize>(trailer.size()));
+        Expect(m_stream->good(), "error: failed to write png");
+    }
+
+    // picks the filter with the smallest sum of absolute (signed) residuals, the usual heuristic
+    auto FilterRow(uint8_t const* row, uint8_t const* above, uint8_t* output) const -> void
+    {
+        size_t const stride = m_width * 3;
+
+        // the filter is a template argument so every residual loop is branch free and vectorizes
+        auto residuals = [&](auto filter_constant, uint8_t* destination)
+        {
+            static constexpr size_t filter = decltype(filter_constant)::value;
+
+            auto predict = [](int left, int up, int up_left) -> int
+            {
+                if constexpr (filter == 1)
+                {
+                    return left;
+                }
+                else if constexpr (filter == 2)
+                {
+                    return up;
+                }
+                else if constexpr (filter == 3)
+                {
+                    return (left + up) / 2;
+                }
+                else if constexpr (filter == 4)
+                {
+                    int estimate = left + up - up_left;
+                    int distance_left = std::abs(estimate - left);
+                    int distance_up = std::abs(estimate - up);
+                    int distance_up_left = std::abs(estimate - up_left);
+                    return (distance_left <= distance_up && distance_left <= distance_up_left) ? left : (distance_up <= distance_up_left ? up : up_left);
+                }
+                else
+                {
+                    return 0;
+                }
+            };
+
+            // the first pixel has no left neighbors
+            for (size_t index = 0; index < 3; ++index)
+            {
+                destination[index] = static_cast<uint8_t>(row[index] - predict(0, above[index], 0));
+            }
+            for (size_t index = 3; index < stride; ++index)
+            {
+                destination[index] = static_cast<uint8_t>(row[index] - predict(row[index - 3], above[index], above[index - 3]));
+            }
+        };
+
+        auto cost = [&](uint8_t const* candidate) -> uint64_t
+        {
+            uint64_t sum = 0;
+            for (size_t index = 0; index < stride; ++index)
+            {
+                sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[index])));
+            }
+            return sum;
+        };
+
+        // the best filtering so far is kept in the output, the one being tried in a scratch row
+        std::vector<uint8_t> candidate(stride);
+        output[0] = 0;
+        residuals(std::integral_constant<size_t, 0>(), output + 1);
+        uint64_t best_cost = cost(output + 1);
+
+        auto attempt = [&](auto filter_constant)
+        {
+            residuals(filter_constant, candidate.data());
+            uint64_t candidate_cost = cost(candidate.data());
+            if (candidate_cost < best_cost)
+            {
+                best_cost = candidate_cost;
+                output[0] = static_cast<uint8_t>(decltype(filter_constant)::value);
+                std::copy(candidate.begin(), candidate.end(), output + 1);
+            }
+        };
+
+        attempt(std::integral_constant<size_t, 1>());
+        attempt(std::integral_constant<size_t, 2>());
+        attempt(std::integral_constant<size_t, 3>());
+        attempt(std::integral_constant<size_t, 4>());
+    }
+
+    ThreadPool* m_pool; // null to encode on the calling thread
+    std::ostream* m_stream;
+    std::ofstream m_file; // what m_stream points to when writing a file
+    size_t m_width;
+    size_t m_height;
+    int m_level;
+
+    size_t m_rows_written;
+    uint32_t m_adler;                   // checksum of the filtered rows so far
+    std::vector<uint8_t> m_previous_row; // unfiltered, for the up and paeth filters (zeros before the first row)
+    std::vector<uint8_t> m_dictionary;   // last k_deflate_window bytes of filtered rows
+};
+
+/** @brief Encode an rgb image as a png, filtering and compressing it on every worker of a thread pool.
+ * @param[in] pool The worker threads to encode on.
+ * @param[in] filename The path to write to.
+ * @param[in] rgb A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ * @param[in] level The deflate compression level (0 - 9).
+ */
+auto EncodePng(ThreadPool& pool, std::string const& filename, Tensor<uint8_t, 3> const& rgb, int level = k_default_deflate_level) -> void
 {
     auto [height, width, channels] = rgb.Shape();
     Expect(channels == 3, "error: input tensor must have 3 channels (RGB)");
 
-    auto error = lodepng::encode(filename, rgb.Data(), width, height, LCT_RGB, 8);
-    Expect(!error, "error: " + std::string(lodepng_error_text(error)));
+    PngWriter writer(pool, filename, width, height, level);
+    writer.WriteRows(rgb);
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Tensor.hpp>
+
+#include "Expect.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/*
+
+    uncompressed image output for pipelines that post-process the pixels, where deflating a png is wasted work
+
+    a binary ppm (P6) is a short text header followed by the interleaved rgb bytes; raw output is the same bytes with
+    no header at all, so the reader has to be told the dimensions; both keep the pixels contiguous at a fixed offset,
+    which also makes them suitable for writing through a memory mapping (see MappedFile)
+
+*/
+
+/** @brief Build the header of a binary ppm image.
+ * @param[in] width The width of the image in pixels.
+ * @param[in] height The height of the image in pixels.
+ * @returns The header, ending right where the pixel bytes start.
+ */
+auto PpmHeader(size_t width, size_t height) -> std::string
+{
+    return "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+}
+
+// writes an uncompressed rgb image (a binary ppm, or raw bytes) a band of rows at a time
+class RawImageWriter
+{
+public:
+
+    /** @brief Create the file and write the header, if any.
+     * @param[in] filename The path to write to.
+     * @param[in] width The width of the image in pixels.
+     * @param[in] height The height of the image in pixels.
+     * @param[in] header The bytes that precede the pixels (PpmHeader() for a ppm, empty for raw rgb).
+     */
+    RawImageWriter(std::string const& filename, size_t width, size_t height, std::string const& header)
+        : m_file(filename, std::ios::binary)
+        , m_width(width)
+        , m_height(height)
+        , m_rows_written(0)
+    {
+        Expect(m_file.good(), "error: could not open " + filename + " for writing");
+
+        m_file.write(header.data(), static_cast<std::streamsize>(header.size()));
+        Expect(m_file.good(), "error: failed to write image");
+    }
+
+    /** @brief Write the next band of rows; the file is finished once the last row is written.
+     * @param[in] rows A 3D tensor (rows x width x 3) representing an interleaved RGB band of the image.
+     */
+    auto WriteRows(Tensor<uint8_t, 3> const& rows) -> void
+    {
+        auto [row_count, width, channels] = rows.Shape();
+        Expect(channels == 3 && width == m_width, "error: band does not match the width of the image");
+        Expect(row_count > 0 && m_rows_written + row_count <= m_height, "error: band does not fit in the rows left in the image");
+
+        m_file.write(reinterpret_cast<char const*>(rows.Data()), static_cast<std::streamsize>(row_count * width * 3));
+        Expect(m_file.good(), "error: failed to write image");
+
+        m_rows_written += row_count;
+        if (m_rows_written == m_height)
+        {
+            m_file.close();
+            Expect(!m_file.fail(), "error: failed to write image");
+        }
+    }
+
+private:
+
+    std::ofstream m_file;
+    size_t m_width;
+    size_t m_height;
+    size_t m_rows_written;
+};
+
+/** @brief Write an rgb image as a binary ppm.
+ * @param[in] filename The path to write to.
+ * @param[in] rgb A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ */
+auto EncodePpm(std::string const& filename, Tensor<uint8_t, 3> const& rgb) -> void
+{
+    auto [height, width, channels] = rgb.Shape();
+    Expect(channels == 3, "error: input tensor must have 3 channels (RGB)");
+
+    RawImageWriter writer(filename, width, height, PpmHeader(width, height));
+    writer.WriteRows(rgb);
+}
+
+/** @brief Write an rgb image as raw interleaved bytes, with no header.
+ * @param[in] filename The path to write to.
+ * @param[in] rgb A 3D tensor (height x width x 3) representing an interleaved RGB image.
+ */
+auto EncodeRaw(std::string const& filename, Tensor<uint8_t, 3> const& rgb) -> void
+{
+    auto [height, width, channels] = rgb.Shape();
+    Expect(channels == 3, "error: input tensor must have 3 channels (RGB)");
+
+    RawImageWriter writer(filename, width, height, "");
+    writer.WriteRows(rgb);
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+/*
+
+    a fixed set of worker threads that live as long as the pool does
+
+    starting threads is cheap compared to a single render, but not compared to the thousands of frames of an animation
+    or batch job, so callers create one pool up front and hand it to every render
+
+*/
+
+class ThreadPool
+{
+public:
+
+    /** @brief Start the worker threads.
+     * @param[in] thread_count The number of workers, or 0 for one per hardware thread.
+     * @param[in] pin_threads Whether to pin worker i to logical cpu i (ignored on platforms without thread affinity).
+     */
+    explicit ThreadPool(size_t thread_count = 0, bool pin_threads = false)
+    {
+        if (thread_count == 0)
+        {
+            thread_count = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+        }
+
+        m_threads.reserve(thread_count);
+        for (size_t index = 0; index < thread_count; ++index)
+        {
+            m_threads.emplace_back([this, index]()
+            {
+                WorkerLoop(index);
+            });
+
+            if (pin_threads)
+            {
+                Pin(m_threads.back(), index);
+            }
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+
+        m_wake.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    auto operator=(ThreadPool const&) -> ThreadPool& = delete;
+
+    auto Size() const -> size_t
+    {
+        return m_threads.size();
+    }
+
+    /** @brief Run a function on every worker and wait for all of them to return.
+     *
+     * Calls from several threads at once are serialized. The first exception thrown by a worker is rethrown here.
+     *
+     * @param[in] function The function to run, called as function(worker_index) once per worker.
+     */
+    auto Run(std::function<void(size_t)> const& function) -> void
+    {
+        std::lock_guard run_lock(m_run_mutex);
+
+        std::unique_lock lock(m_mutex);
+        m_job = &function;
+        m_remaining = m_threads.size();
+        m_error = nullptr;
+        ++m_generation;
+        lock.unlock();
+
+        m_wake.notify_all();
+
+        lock.lock();
+        m_done.wait(lock, [&]()
+        {
+            return m_remaining == 0;
+        });
+        m_job = nullptr;
+
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+private:
+
+    auto WorkerLoop(size_t index) -> void
+    {
+        size_t seen_generation = 0;
+
+        while (true)
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [&]()
+            {
+                return m_stopping || m_generation != seen_generation;
+            });
+
+            if (m_stopping)
+            {
+                return;
+            }
+
+            seen_generation = m_generation;
+            auto const* job = m_job;
+            lock.unlock();
+
+            try
+            {
+                (*job)(index);
+            }
+            catch (...)
+            {
+                std::lock_guard error_lock(m_mutex);
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+            }
+
+            lock.lock();
+            if (--m_remaining == 0)
+            {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    static auto Pin(std::thread& thread, size_t index) -> void
+    {
+        size_t cpu = index % std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#elif defined(_WIN32)
+        SetThreadAffinityMask(static_cast<HANDLE>(thread.native_handle()), DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8)));
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_run_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    std::function<void(size_t)> const* m_job = nullptr;
+    size_t m_generation = 0;
+    size_t m_remaining = 0;
+    bool m_stopping = false;
+    std::exception_ptr m_error;
+};
@@ -0,0 +1,99 @@
+#include <FixedPoint.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <stdexcept>
+
+TEST(FixedPoint, ConvertsDoublesExactly)
+{
+    for (double value : {0.0, 1.0, -1.0, 0.1, -2.75, 3.141592653589793, -4294967295.5})
+    {
+        EXPECT_EQ(FixedPoint::FromDouble(value, 4).ToDouble(), value);
+    }
+}
+
+TEST(FixedPoint, HasFixedResolution)
+{
+    // the lowest bit of 1e-30 is worth about 2^-152: below the last of four fraction limbs, within the fifth
+    EXPECT_NE(FixedPoint::FromDouble(1e-30, 4).ToDouble(), 1e-30);
+    EXPECT_NEAR(FixedPoint::FromDouble(1e-30, 4).ToDouble(), 1e-30, std::ldexp(1.0, -128));
+    EXPECT_EQ(FixedPoint::FromDouble(1e-30, 5).ToDouble(), 1e-30);
+
+    // anything below the resolution truncates to zero
+    EXPECT_EQ(FixedPoint::FromDouble(std::ldexp(1.0, -65), 2).ToDouble(), 0.0);
+    EXPECT_EQ(FixedPoint::FromString("1e-20", 2).ToDouble(), 0.0);
+}
+
+TEST(FixedPoint, ParsesDecimals)
+{
+    EXPECT_EQ(FixedPoint::FromString("2", 2).ToDouble(), 2.0);
+    EXPECT_EQ(FixedPoint::FromString("-0.75", 2).ToDouble(), -0.75);
+    EXPECT_EQ(FixedPoint::FromString("+1.5e-3", 4).ToDouble(), 1.5e-3);
+    EXPECT_EQ(FixedPoint::FromString("25e-1", 2).ToDouble(), 2.5);
+    EXPECT_EQ(FixedPoint::FromString(".5", 2).ToDouble(), 0.5);
+
+    EXPECT_THROW(FixedPoint::FromString("", 2), std::runtime_error);
+    EXPECT_THROW(FixedPoint::FromString("1.5x", 2), std::runtime_error);
+    EXPECT_THROW(FixedPoint::FromString("1e", 2), std::runtime_error);
+}
+
+TEST(FixedPoint, KeepsDigitsBeyondDouble)
+{
+    // 1 + 2^-100 is 1 as a double, but the difference survives in fixed point
+    auto tiny = FixedPoint::FromDouble(std::ldexp(1.0, -100), 4);
+    auto one = FixedPoint::FromDouble(1.0, 4);
+    EXPECT_EQ((one + tiny).ToDouble(), 1.0);
+    EXPECT_EQ(((one + tiny) - one).ToDouble(), std::ldexp(1.0, -100));
+
+    // (1 + 2^-100)^2 - 1 = 2^-99 + 2^-200, and 2^-200 is below the resolution of four fraction limbs
+    auto square = (one + tiny) * (one + tiny);
+    EXPECT_EQ((square - one).ToDouble(), std::ldexp(1.0, -99));
+
+    // the decimal digits of a deep zoom center are kept to the last limb
+    auto precise = FixedPoint::FromString("0.1000000000000000000000000000001", 4);
+    auto rounded = FixedPoint::FromString("0.1", 4);
+    EXPECT_NEAR((precise - rounded).ToDouble(), 1e-31, 1e-37);
+}
+
+TEST(FixedPoint, AddsAndMultipliesSignedValues)
+{
+    auto a = FixedPoint::FromDouble(1.5, 2);
+    auto b = FixedPoint::FromDouble(-2.25, 2);
+
+    EXPECT_EQ((a + b).ToDouble(), -0.75);
+    EXPECT_EQ((a - b).ToDouble(), 3.75);
+    EXPECT_EQ((b - a).ToDouble(), -3.75);
+    EXPECT_EQ((b + b).ToDouble(), -4.5);
+    EXPECT_EQ((a * b).ToDouble(), -3.375);
+    EXPECT_EQ((b * b).ToDouble(), 5.0625);
+    EXPECT_EQ((-a).ToDouble(), -1.5);
+
+    // zero never carries a sign
+    EXPECT_FALSE(std::signbit((a - a).ToDouble()));
+    EXPECT_FALSE(std::signbit((b * FixedPoint(2)).ToDouble()));
+    EXPECT_FALSE(std::signbit((-FixedPoint(2)).ToDouble()));
+}
+
+TEST(FixedPoint, RejectsValuesOutOfRange)
+{
+    EXPECT_THROW(FixedPoint::FromDouble(4294967296.0, 2), std::overflow_error);
+    EXPECT_THROW(FixedPoint::FromDouble(-4294967296.0, 2), std::overflow_error);
+    EXPECT_THROW(FixedPoint::FromDouble(INFINITY, 2), std::overflow_error);
+    EXPECT_THROW(FixedPoint::FromString("4294967296", 2), std::overflow_error);
+
+    auto large = FixedPoint::FromDouble(4294967295.0, 2);
+    auto one = FixedPoint::FromDouble(1.0, 2);
+    EXPECT_THROW(large + one, std::overflow_error);
+    EXPECT_THROW(-large - one, std::overflow_error);
+    EXPECT_EQ((large - one).ToDouble(), 4294967294.0);
+
+    auto root = FixedPoint::FromDouble(65536.0, 2);
+    EXPECT_THROW(root * root, std::overflow_error);
+    EXPECT_EQ((root * FixedPoint::FromDouble(65535.99, 2)).ToDouble(), 65536.0 * FixedPoint::FromDouble(65535.99, 2).ToDouble());
+}
+
+TEST(FixedPoint, RejectsMixedPrecision)
+{
+    EXPECT_THROW(FixedPoint(2) + FixedPoint(3), std::runtime_error);
+}
@@ -0,0 +1,133 @@
+#include <HttpServer.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// requests answered at once by the test server, fewer than some tests send, so connections have to queue
+static constexpr size_t k_server_threads = 2;
+
+auto HandleTestRequest(std::string const& target) -> HttpResponse
+{
+    if (target == "/hello")
+    {
+        return {200, "text/plain", "hello\n"};
+    }
+    if (target == "/slow")
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return {200, "text/plain", "slow\n"};
+    }
+    if (target == "/throw")
+    {
+        throw std::runtime_error("handler failed");
+    }
+    return {404, "text/plain", "not found\n"};
+}
+
+// Serve() never returns, so every test talks to one server that runs until the process exits
+auto GetServerPort() -> uint16_t
+{
+    static uint16_t const port = []()
+    {
+        auto* server = new HttpServer(0);
+        std::thread([server]()
+        {
+            server->Serve(HandleTestRequest, k_server_threads);
+        }).detach();
+        return server->Port();
+    }();
+    return port;
+}
+
+// sends a raw request to the test server over loopback and returns everything it answers until it closes
+auto SendRequest(std::string const& request) -> std::string
+{
+    uint16_t port = GetServerPort(); // also initializes sockets on windows
+
+#if defined(_WIN32)
+    SOCKET client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    EXPECT_NE(client, INVALID_SOCKET);
+#else
+    int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    EXPECT_GE(client, 0);
+#endif
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    EXPECT_EQ(connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+
+    EXPECT_EQ(send(client, request.data(), static_cast<int>(request.size()), 0), static_cast<int>(request.size()));
+
+    std::string response;
+    for (;;)
+    {
+        char buffer[4096];
+        auto received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            break;
+        }
+        response.append(buffer, static_cast<size_t>(received));
+    }
+
+#if defined(_WIN32)
+    closesocket(client);
+#else
+    close(client);
+#endif
+    return response;
+}
+
+auto Get(std::string const& target) -> std::string
+{
+    return SendRequest("GET " + target + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+}
+
+TEST(HttpServer, AnswersGetRequests)
+{
+    EXPECT_EQ(Get("/hello"), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\nConnection: close\r\n\r\nhello\n");
+}
+
+TEST(HttpServer, AnswersHeadRequestsWithoutABody)
+{
+    EXPECT_EQ(SendRequest("HEAD /hello HTTP/1.1\r\n\r\n"), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\nConnection: close\r\n\r\n");
+}
+
+TEST(HttpServer, ReportsErrors)
+{
+    EXPECT_EQ(Get("/missing").rfind("HTTP/1.1 404 Not Found\r\n", 0), 0u);
+    EXPECT_EQ(Get("/throw"), "HTTP/1.1 500 Internal Server Error\r\nContent-Type: text/plain\r\nContent-Length: 15\r\nConnection: close\r\n\r\nhandler failed\n");
+    EXPECT_EQ(SendRequest("POST /hello HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 405 Method Not Allowed\r\n", 0), 0u);
+    EXPECT_EQ(SendRequest("GARBAGE\r\n\r\n").rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u);
+}
+
+TEST(HttpServer, QueuesMoreConnectionsThanThreads)
+{
+    static constexpr size_t k_client_count = 4 * k_server_threads;
+
+    std::vector<std::string> responses(k_client_count);
+    std::vector<std::thread> clients;
+    for (size_t index = 0; index < k_client_count; ++index)
+    {
+        clients.emplace_back([&, index]()
+        {
+            responses[index] = Get("/slow");
+        });
+    }
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    for (auto const& response : responses)
+    {
+        EXPECT_EQ(response, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\nConnection: close\r\n\r\nslow\n");
+    }
+}
@@ -0,0 +1,138 @@
+#include <LruCache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using StringCache = LruCache<int, std::string>;
+
+auto GetStringCache(size_t capacity) -> StringCache
+{
+    return StringCache(capacity, [](std::string const& value) { return value.size(); });
+}
+
+// looks a key up, reporting whether it had to be computed
+auto WasComputed(StringCache& cache, int key, std::string const& value) -> bool
+{
+    bool computed = false;
+    auto result = cache.GetOrCompute(key, [&]()
+    {
+        computed = true;
+        return value;
+    });
+    EXPECT_EQ(*result, value);
+    return computed;
+}
+
+TEST(LruCache, ComputesOnlyOnAMiss)
+{
+    auto cache = GetStringCache(100);
+
+    EXPECT_TRUE(WasComputed(cache, 1, "one"));
+    EXPECT_FALSE(WasComputed(cache, 1, "one"));
+    EXPECT_EQ(cache.Size(), 3u);
+}
+
+TEST(LruCache, EvictsTheLeastRecentlyUsedFirst)
+{
+    auto cache = GetStringCache(10);
+
+    EXPECT_TRUE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbbb"));
+
+    // 6 more bytes only fit once the oldest entry is gone
+    EXPECT_TRUE(WasComputed(cache, 3, "cccccc"));
+    EXPECT_EQ(cache.Size(), 10u);
+
+    EXPECT_FALSE(WasComputed(cache, 2, "bbbb"));
+    EXPECT_FALSE(WasComputed(cache, 3, "cccccc"));
+    EXPECT_TRUE(WasComputed(cache, 1, "aaaa"));
+}
+
+TEST(LruCache, HitsRenewRecency)
+{
+    auto cache = GetStringCache(12);
+
+    EXPECT_TRUE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbbb"));
+    EXPECT_TRUE(WasComputed(cache, 3, "cccc"));
+
+    // using 1 again makes 2 the least recently used
+    EXPECT_FALSE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_TRUE(WasComputed(cache, 4, "dddd"));
+
+    EXPECT_FALSE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_FALSE(WasComputed(cache, 3, "cccc"));
+    EXPECT_FALSE(WasComputed(cache, 4, "dddd"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbbb"));
+}
+
+TEST(LruCache, EvictsAsManyEntriesAsItTakes)
+{
+    auto cache = GetStringCache(10);
+
+    EXPECT_TRUE(WasComputed(cache, 1, "aaa"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbb"));
+    EXPECT_TRUE(WasComputed(cache, 3, "ccc"));
+    EXPECT_TRUE(WasComputed(cache, 4, "dddddddd"));
+    EXPECT_EQ(cache.Size(), 8u);
+
+    EXPECT_FALSE(WasComputed(cache, 4, "dddddddd"));
+    EXPECT_TRUE(WasComputed(cache, 3, "ccc"));
+}
+
+TEST(LruCache, DoesNotCacheValuesLargerThanItself)
+{
+    auto cache = GetStringCache(4);
+
+    EXPECT_TRUE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbbbb"));
+    EXPECT_EQ(cache.Size(), 4u);
+
+    // the oversized value is returned, but the entries already cached are kept
+    EXPECT_FALSE(WasComputed(cache, 1, "aaaa"));
+    EXPECT_TRUE(WasComputed(cache, 2, "bbbbb"));
+}
+
+TEST(LruCache, DoesNotCacheFailures)
+{
+    auto cache = GetStringCache(100);
+
+    EXPECT_THROW(cache.GetOrCompute(1, []() -> std::string { throw std::runtime_error("failed"); }), std::runtime_error);
+    EXPECT_EQ(cache.Size(), 0u);
+    EXPECT_TRUE(WasComputed(cache, 1, "one"));
+}
+
+TEST(LruCache, CoalescesConcurrentMisses)
+{
+    static constexpr size_t k_thread_count = 8;
+
+    auto cache = GetStringCache(100);
+    std::atomic<size_t> computations = 0;
+
+    std::vector<std::thread> threads;
+    for (size_t index = 0; index < k_thread_count; ++index)
+    {
+        threads.emplace_back([&]()
+        {
+            auto value = cache.GetOrCompute(1, [&]()
+            {
+                ++computations;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50)); // long enough for every thread to miss
+                return std::string("one");
+            });
+            EXPECT_EQ(*value, "one");
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(computations, 1u);
+}
@@ -0,0 +1,88 @@
+#include "Server.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+// the limit a test server allows requests to ask for
+static constexpr size_t k_test_max_iterations = 5000;
+
+auto GetDefaultKey() -> MapTileKey
+{
+    MapTileKey defaults;
+    defaults.max_iterations = 250;
+    defaults.colormap = Colormap::Twilight;
+    return defaults;
+}
+
+// parses a target against the test defaults, returning the status and leaving the tile in key
+auto Parse(std::string const& target, MapTileKey& key) -> int
+{
+    return ParseMapTileTarget(target, GetDefaultKey(), k_test_max_iterations, key);
+}
+
+auto Parse(std::string const& target) -> int
+{
+    MapTileKey key;
+    return Parse(target, key);
+}
+
+TEST(MapTileTarget, ParsesThePathAndKeepsTheDefaults)
+{
+    MapTileKey key;
+    ASSERT_EQ(Parse("/3/5/2.png", key), 200);
+    EXPECT_EQ(key.level, 3u);
+    EXPECT_EQ(key.x, 5u);
+    EXPECT_EQ(key.y, 2u);
+    EXPECT_EQ(key.max_iterations, 250u);
+    EXPECT_EQ(key.colormap, Colormap::Twilight);
+}
+
+TEST(MapTileTarget, ParsesTheQuery)
+{
+    MapTileKey key;
+    ASSERT_EQ(Parse("/0/0/0.png?iterations=1000&colormap=viridis", key), 200);
+    EXPECT_EQ(key.max_iterations, 1000u);
+    EXPECT_EQ(key.colormap, Colormap::Viridis);
+
+    // unknown parameters are ignored
+    ASSERT_EQ(Parse("/0/0/0.png?colormap=magma&cachebust=17", key), 200);
+    EXPECT_EQ(key.max_iterations, 250u);
+    EXPECT_EQ(key.colormap, Colormap::Magma);
+}
+
+TEST(MapTileTarget, RejectsMalformedPaths)
+{
+    for (char const* target : {"/", "/0/0/0", "/0/0/0.jpg", "0/0/0.png", "/0/0.png", "/0/0/0/0.png", "/a/0/0.png", "/0/-1/0.png", "/0//0.png", "/0/0/0.png/"})
+    {
+        EXPECT_EQ(Parse(target), 404) << target;
+    }
+}
+
+TEST(MapTileTarget, RejectsTilesOutsideTheirLevel)
+{
+    EXPECT_EQ(Parse("/2/3/3.png"), 200);
+    EXPECT_EQ(Parse("/2/4/0.png"), 404);
+    EXPECT_EQ(Parse("/2/0/4.png"), 404);
+
+    EXPECT_EQ(Parse("/" + std::to_string(k_max_map_levels) + "/0/0.png"), 200);
+    EXPECT_EQ(Parse("/" + std::to_string(k_max_map_levels + 1) + "/0/0.png"), 404);
+}
+
+TEST(MapTileTarget, RejectsInvalidQueries)
+{
+    EXPECT_EQ(Parse("/0/0/0.png?iterations=0"), 400);
+    EXPECT_EQ(Parse("/0/0/0.png?iterations="), 400);
+    EXPECT_EQ(Parse("/0/0/0.png?iterations=12x"), 400);
+    EXPECT_EQ(Parse("/0/0/0.png?iterations=3000000000"), 400);
+    EXPECT_EQ(Parse("/0/0/0.png?colormap=magmaa"), 400);
+    EXPECT_EQ(Parse("/0/0/0.png?colormap="), 400);
+}
+
+TEST(MapTileTarget, CapsTheIterationLimit)
+{
+    MapTileKey key;
+    ASSERT_EQ(Parse("/0/0/0.png?iterations=" + std::to_string(k_test_max_iterations), key), 200);
+    EXPECT_EQ(key.max_iterations, k_test_max_iterations);
+    EXPECT_EQ(Parse("/0/0/0.png?iterations=" + std::to_string(k_test_max_iterations + 1)), 400);
+}
@@ -0,0 +1,197 @@
+#include <ThreadPool.hpp>
+
+#include "Engine.hpp"
+#include "RenderParams.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <complex>
+#include <string>
+
+// a view ten orders of magnitude past double precision, small enough to render in a moment
+auto GetDeepParams() -> RenderParams
+{
+    RenderParams params;
+    params.width = 96;
+    params.height = 64;
+    params.center_real_digits = "-0.743643887037158704752191506114774";
+    params.center_imag_digits = "0.131825904205311970493132056385139";
+    params.center_real = std::stod(params.center_real_digits);
+    params.center_imag = std::stod(params.center_imag_digits);
+    params.zoom = 1e14;
+    params.max_iterations = 5000;
+    return params;
+}
+
+// a view double precision still resolves, so the double precision scalar kernel gives the true image
+auto GetShallowParams() -> RenderParams
+{
+    RenderParams params;
+    params.width = 240;
+    params.height = 160;
+    params.center_real = -0.743643887;
+    params.center_imag = 0.131825904;
+    params.zoom = 2000.0;
+    params.max_iterations = 1000;
+    params.precision = Precision::Double;
+    return params;
+}
+
+// number of pixels whose smoothed iteration counts differ by more than one iteration
+auto CountMismatches(Tensor<float, 2> const& actual, Tensor<float, 2> const& expected) -> size_t
+{
+    auto [height, width] = expected.Shape();
+    size_t mismatches = 0;
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            mismatches += std::abs(actual({y, x}) - expected({y, x})) > 1.0f;
+        }
+    }
+    return mismatches;
+}
+
+auto ExpectSameReference(PerturbationReference const& actual, PerturbationReference const& expected) -> void
+{
+    EXPECT_EQ(actual.orbit, expected.orbit);
+    EXPECT_EQ(actual.series.skipped, expected.series.skipped);
+    EXPECT_EQ(actual.series.radius, expected.series.radius);
+    EXPECT_EQ(actual.series.coefficients, expected.series.coefficients);
+}
+
+auto ExpectSameImage(Tensor<float, 2> const& actual, Tensor<float, 2> const& expected) -> void
+{
+    ASSERT_EQ(actual.Shape(), expected.Shape());
+
+    auto [height, width] = expected.Shape();
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            ASSERT_EQ(actual({y, x}), expected({y, x})) << "at row " << y << ", column " << x;
+        }
+    }
+}
+
+TEST(Perturbation, DeepViewsSwitchToPerturbation)
+{
+    auto params = GetDeepParams();
+    EXPECT_EQ(ResolveEngine(Engine::BruteForce, params), Engine::Perturbation);
+    EXPECT_TRUE(PrepareReference(Engine::BruteForce, params).has_value());
+
+    params.zoom = 1.0;
+    EXPECT_EQ(ResolveEngine(Engine::BruteForce, params), Engine::BruteForce);
+    EXPECT_FALSE(PrepareReference(Engine::BruteForce, params).has_value());
+}
+
+TEST(Perturbation, SeriesApproximationKeepsTheImage)
+{
+    ThreadPool pool(2);
+    auto params = GetShallowParams();
+    auto expected = Compute(pool, Engine::Generic, params, LaneMode::Grouped, k_default_tile_size, false);
+
+    auto reference = ComputePerturbationReference(params);
+    ASSERT_GT(reference.series.skipped, 0u);
+    auto with_series = MandelbrotPerturbation(pool, params, reference, k_default_tile_size, false);
+
+    // perturbation already rounds differently from the scalar kernel on chaotic pixels near the boundary; skipping
+    // iterations with the series must not add to that
+    reference.series.skipped = 0;
+    auto without_series = MandelbrotPerturbation(pool, params, reference, k_default_tile_size, false);
+
+    EXPECT_LE(CountMismatches(with_series, expected), CountMismatches(without_series, expected));
+}
+
+TEST(Perturbation, RebasesGlitchesAtEveryZoom)
+{
+    ThreadPool pool(2);
+
+    for (double zoom : {1e10, 1e170, 1e290})
+    {
+        SCOPED_TRACE(testing::Message() << "zoom " << zoom);
+
+        // a view whose left half lies closer to zero than to the reference at its center, so those pixels glitch on
+        // their first iteration; past a zoom of about 1e150 their squared magnitudes underflow to zero
+        RenderParams params;
+        params.width = 32;
+        params.height = 16;
+        params.center_real = 0.5 / zoom;
+        params.center_imag = 0.0;
+        params.zoom = zoom;
+        params.max_iterations = 100;
+
+        std::complex<double> delta_c(-1.5 / zoom, 0.0);
+        std::complex<double> z = params.center_real + delta_c;
+        EXPECT_TRUE(IsGlitched(z.real(), z.imag(), delta_c.real(), delta_c.imag()));
+        EXPECT_FALSE(IsGlitched(params.center_real - delta_c.real(), 0.0, -delta_c.real(), 0.0));
+
+        // the corner probes glitch, so no iterations can be skipped
+        auto reference = ComputePerturbationReference(params);
+        EXPECT_EQ(reference.series.skipped, 0u);
+
+        // every pixel lies in the main cardioid; rebasing must keep them there
+        auto image = MandelbrotPerturbation(pool, params, reference, k_default_tile_size, false);
+        for (float value : image)
+        {
+            ASSERT_EQ(value, static_cast<float>(params.max_iterations));
+        }
+    }
+}
+
+TEST(Perturbation, PartsShareTheReferenceOfTheImage)
+{
+    auto params = GetDeepParams();
+    auto whole = ComputePerturbationReference(params);
+    EXPECT_GT(whole.series.skipped, 0u);
+
+    RenderParams band = params;
+    band.image_height = params.height;
+    band.first_row = 40;
+    band.height = 8;
+    ExpectSameReference(ComputePerturbationReference(band), whole);
+
+    RenderParams lattice = params;
+    lattice.image_height = params.height;
+    lattice.image_width = params.width;
+    lattice.height = params.height / 4;
+    lattice.width = params.width / 4;
+    lattice.sample_stride = 4;
+    lattice.sample_row = 1;
+    lattice.sample_column = 3;
+    ExpectSameReference(ComputePerturbationReference(lattice), whole);
+}
+
+TEST(Perturbation, BandsMatchTheWholeImage)
+{
+    ThreadPool pool(2);
+    auto params = GetDeepParams();
+    auto whole = Compute(pool, Engine::Perturbation, params, LaneMode::Grouped, k_default_tile_size, false);
+
+    // a band height that does not divide the image, so the last band is shorter
+    auto banded = Tensor<float, 2>({params.height, params.width});
+    ComputeBands(pool, Engine::Perturbation, params, LaneMode::Grouped, k_default_tile_size, 24, [&](size_t first_row, Tensor<float, 2> const& band)
+    {
+        auto [band_height, band_width] = band.Shape();
+        for (size_t y = 0; y < band_height; ++y)
+        {
+            for (size_t x = 0; x < band_width; ++x)
+            {
+                banded({first_row + y, x}) = band({y, x});
+            }
+        }
+    });
+
+    ExpectSameImage(banded, whole);
+}
+
+TEST(Perturbation, ProgressivePassesMatchTheWholeImage)
+{
+    ThreadPool pool(2);
+    auto params = GetDeepParams();
+    auto whole = Compute(pool, Engine::Perturbation, params, LaneMode::Grouped, k_default_tile_size, false);
+
+    auto progressive = ComputeProgressive(pool, Engine::Perturbation, params, LaneMode::Grouped, k_default_tile_size, k_default_progressive_stride, [](size_t, Tensor<float, 2> const&) {});
+    ExpectSameImage(progressive, whole);
+}
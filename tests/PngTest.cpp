@@ -0,0 +1,214 @@
+#include <PNG.hpp>
+#include <ThreadPool.hpp>
+
+#include <lodepng.h>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+// smooth gradients with noisy patches, so deflate finds long matches that run across piece boundaries
+auto GetTestImage(size_t width, size_t height) -> Tensor<uint8_t, 3>
+{
+    Tensor<uint8_t, 3> rgb({height, width, 3});
+    std::mt19937 generator(static_cast<uint32_t>(width * 31 + height));
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            bool noisy = ((x / 16) + (y / 16)) % 5 == 0;
+            rgb({y, x, 0}) = static_cast<uint8_t>(noisy ? generator() : x);
+            rgb({y, x, 1}) = static_cast<uint8_t>(noisy ? generator() : y);
+            rgb({y, x, 2}) = static_cast<uint8_t>(noisy ? generator() : x + y);
+        }
+    }
+    return rgb;
+}
+
+// the rows [first, first + count) of an image
+auto GetBand(Tensor<uint8_t, 3> const& rgb, size_t first, size_t count) -> Tensor<uint8_t, 3>
+{
+    auto [height, width, channels] = rgb.Shape();
+    Tensor<uint8_t, 3> band({count, width, channels});
+    for (size_t y = 0; y < count; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            for (size_t channel = 0; channel < channels; ++channel)
+            {
+                band({y, x, channel}) = rgb({first + y, x, channel});
+            }
+        }
+    }
+    return band;
+}
+
+auto ExpectDecodesTo(std::string const& png, Tensor<uint8_t, 3> const& expected) -> void
+{
+    auto [height, width, channels] = expected.Shape();
+
+    std::vector<unsigned char> pixels;
+    unsigned decoded_width = 0;
+    unsigned decoded_height = 0;
+    unsigned error = lodepng::decode(pixels, decoded_width, decoded_height, std::vector<unsigned char>(png.begin(), png.end()), LCT_RGB, 8);
+    ASSERT_EQ(error, 0u) << lodepng_error_text(error);
+    ASSERT_EQ(decoded_width, width);
+    ASSERT_EQ(decoded_height, height);
+    ASSERT_EQ(pixels.size(), height * width * channels);
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width * channels; ++x)
+        {
+            ASSERT_EQ(pixels[y * width * channels + x], expected.Data()[y * width * channels + x]) << "at row " << y << ", byte " << x;
+        }
+    }
+}
+
+// encodes in memory on the calling thread
+auto EncodeInMemory(Tensor<uint8_t, 3> const& rgb, size_t band_height, int level = k_default_deflate_level) -> std::string
+{
+    auto [height, width, channels] = rgb.Shape();
+
+    std::ostringstream stream;
+    PngWriter writer(stream, width, height, level);
+    for (size_t first = 0; first < height; first += band_height)
+    {
+        writer.WriteRows(GetBand(rgb, first, std::min(band_height, height - first)));
+    }
+    return stream.str();
+}
+
+// encodes to a file on a thread pool, which deflates the pieces of a band in parallel
+auto EncodeOnPool(ThreadPool& pool, Tensor<uint8_t, 3> const& rgb, size_t band_height, int level = k_default_deflate_level) -> std::string
+{
+    auto [height, width, channels] = rgb.Shape();
+    auto path = std::filesystem::temp_directory_path() / ("PngTest-" + std::to_string(width) + "x" + std::to_string(height) + ".png");
+    {
+        PngWriter writer(pool, path.string(), width, height, level);
+        for (size_t first = 0; first < height; first += band_height)
+        {
+            writer.WriteRows(GetBand(rgb, first, std::min(band_height, height - first)));
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::string png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::filesystem::remove(path);
+    return png;
+}
+
+// a scanline of 341 pixels is a filter byte and 1023 bytes: 1 KiB, so 128 rows fill one 128 KiB piece exactly
+static constexpr size_t k_piece_width = 341;
+static constexpr size_t k_piece_rows = 128;
+
+TEST(Png, DecodesAnImageOfOnePiece)
+{
+    auto rgb = GetTestImage(k_piece_width, k_piece_rows);
+    ExpectDecodesTo(EncodeInMemory(rgb, k_piece_rows), rgb);
+}
+
+TEST(Png, DecodesAnImageOfWholePieces)
+{
+    ThreadPool pool(4);
+
+    auto rgb = GetTestImage(k_piece_width, 3 * k_piece_rows);
+    ExpectDecodesTo(EncodeInMemory(rgb, 3 * k_piece_rows), rgb);
+    ExpectDecodesTo(EncodeOnPool(pool, rgb, 3 * k_piece_rows), rgb);
+}
+
+TEST(Png, DecodesAnImageWithAShorterLastPiece)
+{
+    ThreadPool pool(4);
+
+    // three full pieces and one of a single row
+    auto rgb = GetTestImage(k_piece_width, 3 * k_piece_rows + 1);
+    ExpectDecodesTo(EncodeInMemory(rgb, 3 * k_piece_rows + 1), rgb);
+    ExpectDecodesTo(EncodeOnPool(pool, rgb, 3 * k_piece_rows + 1), rgb);
+
+    // pieces that end part way through a row
+    auto odd = GetTestImage(300, 500);
+    ExpectDecodesTo(EncodeInMemory(odd, 500), odd);
+    ExpectDecodesTo(EncodeOnPool(pool, odd, 500), odd);
+}
+
+TEST(Png, DecodesBandsOfSeveralPieces)
+{
+    ThreadPool pool(4);
+
+    // every band spans pieces, and the last band is shorter than the rest
+    auto rgb = GetTestImage(k_piece_width, 5 * k_piece_rows + 7);
+    ExpectDecodesTo(EncodeInMemory(rgb, 2 * k_piece_rows), rgb);
+    ExpectDecodesTo(EncodeOnPool(pool, rgb, 2 * k_piece_rows + 3), rgb);
+}
+
+TEST(Png, RoundTripsAtEveryLevel)
+{
+    ThreadPool pool(4);
+
+    // 37 does not divide 300, so the last band is shorter than the rest
+    auto rgb = GetTestImage(257, 300);
+    for (int level : {0, 1, 6, 9})
+    {
+        SCOPED_TRACE("level " + std::to_string(level));
+        ExpectDecodesTo(EncodeInMemory(rgb, 37, level), rgb);
+        ExpectDecodesTo(EncodeOnPool(pool, rgb, 37, level), rgb);
+    }
+}
+
+TEST(Png, RecordsTheLevelInTheZlibHeader)
+{
+    // the stream starts in the data of the first IDAT chunk, after the signature (8 bytes), the IHDR chunk (25 bytes),
+    // and the length and type of the IDAT chunk (8 bytes)
+    static constexpr size_t k_zlib_header_offset = 41;
+
+    auto rgb = GetTestImage(16, 16);
+    std::vector<std::pair<int, uint8_t>> const flags = {{0, 0x01}, {1, 0x01}, {2, 0x5e}, {5, 0x5e}, {6, 0x9c}, {7, 0xda}, {9, 0xda}};
+    for (auto [level, flag] : flags)
+    {
+        std::string png = EncodeInMemory(rgb, 16, level);
+        ASSERT_GT(png.size(), k_zlib_header_offset + 2);
+        EXPECT_EQ(static_cast<uint8_t>(png[k_zlib_header_offset]), 0x78) << "level " << level;
+        EXPECT_EQ(static_cast<uint8_t>(png[k_zlib_header_offset + 1]), flag) << "level " << level;
+    }
+}
+
+TEST(Png, SplitsLargeBandsIntoSeveralChunks)
+{
+    // one band whose stored (level 0) data is a few times the largest chunk
+    auto rgb = GetTestImage(700, 1500);
+    std::string png = EncodeInMemory(rgb, 1500, 0);
+    ExpectDecodesTo(png, rgb);
+
+    // walk the chunks after the signature: 4 byte length, 4 byte type, data, 4 byte crc
+    size_t idat_chunks = 0;
+    for (size_t offset = 8; offset + 8 <= png.size();)
+    {
+        size_t length = 0;
+        for (size_t index = 0; index < 4; ++index)
+        {
+            length = length << 8 | static_cast<uint8_t>(png[offset + index]);
+        }
+        if (png.compare(offset + 4, 4, "IDAT") == 0)
+        {
+            EXPECT_LE(length, k_max_png_chunk_size);
+            ++idat_chunks;
+        }
+        offset += length + 12;
+    }
+    EXPECT_GT(idat_chunks, 2u);
+}
+
+TEST(Png, RejectsInvalidLevels)
+{
+    auto rgb = GetTestImage(16, 16);
+    EXPECT_THROW(EncodeInMemory(rgb, 16, -1), std::runtime_error);
+    EXPECT_THROW(EncodeInMemory(rgb, 16, 10), std::runtime_error);
+}
@@ -0,0 +1,78 @@
+#include <ThreadPool.hpp>
+
+#include "Reproject.hpp"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+
+// a frame of an animation, zoomed in far enough that it iterates in double precision, so copied and computed pixels
+// agree exactly
+auto GetFrameParams(size_t width, size_t height, double zoom) -> RenderParams
+{
+    RenderParams params;
+    params.width = width;
+    params.height = height;
+    params.center_real = -0.743643887;
+    params.center_imag = 0.131825904;
+    params.zoom = zoom;
+    params.max_iterations = 1000;
+    params.center_on_pixel = true;
+    return params;
+}
+
+TEST(Reproject, LinesUpTwoTimesZoomsOfAnySize)
+{
+    for (auto [width, height] : {std::pair<size_t, size_t>(3840, 2160), {1921, 1081}, {1920, 1081}, {64, 1}})
+    {
+        Reprojection reprojection;
+        ASSERT_TRUE(GetReprojection(GetFrameParams(width, height, 1e9), GetFrameParams(width, height, 2e9), reprojection)) << width << "x" << height;
+        EXPECT_EQ(reprojection.stride, 2u);
+
+        // the center pixel is the same point in both frames
+        EXPECT_EQ(reprojection.sample_column % 2, (width / 2) % 2);
+        EXPECT_EQ(reprojection.previous_column + (width / 2 - reprojection.sample_column) / 2, width / 2);
+        EXPECT_EQ(reprojection.previous_row + (height / 2 - reprojection.sample_row) / 2, height / 2);
+    }
+}
+
+TEST(Reproject, NeedsTheCenterOnAPixelForEvenSizes)
+{
+    auto previous = GetFrameParams(3840, 2160, 1e9);
+    auto params = GetFrameParams(3840, 2160, 2e9);
+    previous.center_on_pixel = false;
+    params.center_on_pixel = false;
+
+    Reprojection reprojection;
+    EXPECT_FALSE(GetReprojection(previous, params, reprojection));
+
+    // odd factors line up either way
+    params.zoom = 3e9;
+    EXPECT_TRUE(GetReprojection(previous, params, reprojection));
+}
+
+TEST(Reproject, CopiesTheSamePixelsItWouldCompute)
+{
+    ThreadPool pool(2);
+
+    for (size_t width : {96, 97})
+    {
+        auto previous_params = GetFrameParams(width, 64, 1e9);
+        auto params = GetFrameParams(width, 64, 2e9);
+
+        auto previous = Compute(pool, Engine::BruteForce, previous_params, LaneMode::Grouped, k_default_tile_size, false);
+
+        size_t reused_pixels = 0;
+        auto reprojected = ComputeReprojected(pool, Engine::BruteForce, previous, previous_params, params, LaneMode::Grouped, k_default_tile_size, reused_pixels, false);
+        auto expected = Compute(pool, Engine::BruteForce, params, LaneMode::Grouped, k_default_tile_size, false);
+
+        EXPECT_EQ(reused_pixels, ((width + 1) / 2) * 32);
+        for (size_t y = 0; y < params.height; ++y)
+        {
+            for (size_t x = 0; x < params.width; ++x)
+            {
+                ASSERT_EQ(reprojected({y, x}), expected({y, x})) << "width " << width << ", at row " << y << ", column " << x;
+            }
+        }
+    }
+}